@@ -0,0 +1,123 @@
+// Counts heap allocations on the CALL path: queueing the call from the ipc thread, running
+// it on the "flash" thread and building the argv in ScriptObject::call_method. The AVM side
+// is a fake vtable whose method is a plain function. Exits with 1 if anything allocated.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include "async_calls.h"
+#include "avm.h"
+
+static std::atomic<bool> g_counting { false };
+static std::atomic<size_t> g_allocations { 0 };
+
+void *operator new(size_t size)
+{
+    if (g_counting.load(std::memory_order_relaxed))
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// Same shape as the ipc CallFunctionMessage
+struct CallMessage
+{
+    avm::ScriptObject *object;
+    uint32_t index;
+    uint32_t argc;
+    uintptr_t argv[64];
+};
+
+static uintptr_t sum_args(avm::MethodEnv *, uint32_t argc, uintptr_t *argv)
+{
+    uintptr_t sum = 0;
+    for (uint32_t i = 1; i <= argc; i++)
+    {
+        sum += argv[i];
+    }
+    return sum;
+}
+
+int main()
+{
+    avm::MethodEnv env { };
+    env.method_proc = sum_args;
+
+    alignas(8) static uint8_t vtable_memory[sizeof(avm::VTable) + 8 * sizeof(uintptr_t)] = { };
+    auto *vtable = reinterpret_cast<avm::VTable *>(vtable_memory);
+    vtable->methods[0] = &env;
+
+    avm::ScriptObject object { };
+    object.vtable = vtable;
+
+    static AsyncCalls calls;
+    std::atomic<bool> running { true };
+    std::thread flash([&]
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            calls.run_pending();
+            std::this_thread::yield();
+        }
+    });
+
+    CallMessage message { &object, 0, 3, { 1, 2, 3 } };
+    constexpr size_t WARMUP = 100, CALLS = 10000;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < WARMUP + CALLS; i++)
+    {
+        if (i == WARMUP)
+        {
+            g_counting = true;
+        }
+
+        uintptr_t value = 0;
+        if (!calls.call_sync([msg = message] { return msg.object->call_method(msg.index, msg.argc, msg.argv); }, &value)
+                || value != 6)
+        {
+            failed++;
+        }
+    }
+
+    g_counting = false;
+    running = false;
+    flash.join();
+
+    size_t allocations = g_allocations.load();
+    std::printf("%zu calls, %zu failed, %zu allocations (%.3f per call)\n",
+                CALLS, failed, allocations, static_cast<double>(allocations) / CALLS);
+    return (allocations || failed) ? 1 : 0;
+}
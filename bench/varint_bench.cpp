@@ -0,0 +1,80 @@
+// Decodes the same buffer of abc u30 varints with the word at a time BinaryStream::read_u32
+// and the byte at a time read_u32_slow, checks that both agree and prints the time per value.
+// The lengths follow roughly what abc data holds: mostly 1 and 2 byte indices.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "binary_stream.h"
+
+static void write_u30(std::vector<uint8_t> &out, uint32_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(value ? (byte | 0x80) : byte);
+    } while (value);
+}
+
+template<typename F>
+static double run(const char *name, const std::vector<uint8_t> &data, size_t count, uint64_t *sum, F &&decode)
+{
+    constexpr int ROUNDS = 50;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t total = 0;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        BinaryStream s(data.data(), data.data() + data.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            total += decode(s);
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    double per_value = elapsed / (static_cast<double>(count) * ROUNDS);
+    std::printf("%-14s %.2f ns/value\n", name, per_value);
+    *sum = total;
+    return per_value;
+}
+
+int main()
+{
+    constexpr size_t COUNT = 1 << 20;
+
+    std::mt19937 rng(42);
+    std::vector<uint32_t> values(COUNT);
+    std::vector<uint8_t> data;
+    for (auto &value : values)
+    {
+        uint32_t kind = rng() % 100;
+        value = (kind < 60) ? rng() % 0x80
+              : (kind < 90) ? rng() % 0x4000
+              : (kind < 98) ? rng() % 0x200000
+              : rng() % 0x40000000;
+        write_u30(data, value);
+    }
+
+    // every value has to decode the same with both
+    BinaryStream fast(data.data(), data.data() + data.size());
+    BinaryStream slow(data.data(), data.data() + data.size());
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        uint32_t a = fast.read_u32(), b = slow.read_u32_slow();
+        if (a != values[i] || b != values[i] || fast.position != slow.position)
+        {
+            std::printf("mismatch at %zu: %u / %u, expected %u\n", i, a, b, values[i]);
+            return 1;
+        }
+    }
+
+    uint64_t fast_sum = 0, slow_sum = 0;
+    double fast_ns = run("read_u32", data, COUNT, &fast_sum, [] (BinaryStream &s) { return s.read_u32(); });
+    double slow_ns = run("read_u32_slow", data, COUNT, &slow_sum, [] (BinaryStream &s) { return s.read_u32_slow(); });
+
+    std::printf("%zu values in %zu bytes, %.2fx\n", COUNT, data.size(), slow_ns / fast_ns);
+    return fast_sum == slow_sum ? 0 : 1;
+}
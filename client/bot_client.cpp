@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cmath>
 #include <charconv>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <chrono>
@@ -11,8 +12,10 @@
 #include <vector>
 #include <sstream>
 
+#include "utf.h"
 #include "utils.h"
 #include "proc_util.h"
+#include "remote_view.h"
 #include "sock_ipc.h"
 
 #include <signal.h>
@@ -28,7 +31,10 @@
 #include <X11/extensions/shape.h>
 
 
-#define MEM_SIZE 1024
+#define MESSAGE_SIZE    1024    // responses that do not fit into a message follow it
+#define TICK_OFFSET     0x4000  // frames published by do_lib every tick
+#define TICK_SIZE       0x10000
+#define MEM_SIZE        (TICK_OFFSET + TICK_SIZE)
 
 namespace window
 {
@@ -650,6 +656,17 @@ enum class MessageType
     KEY_CLICK,
     MOUSE_CLICK,
     CHECK_SIGNATURE,
+    FIND_METHOD,
+    GET_LAYOUT,
+    REGISTER_SCRIPT,
+    UNREGISTER_SCRIPT,
+    REGISTER_READS,
+    UNREGISTER_READS,
+    CALL_CACHE_STATS,
+    BULK_PROPERTY,
+    CHECK_SIGNATURES,
+    FINDDEF,
+    FIND_METHOD_PATTERN,
 
     NONE
 };
@@ -674,6 +691,10 @@ struct FunctionResultMessage
     MessageType type = MessageType::RESULT;
     bool error = false;
     uintptr_t value;
+
+    uint8_t value_type;
+    uint32_t string_size;
+    bool truncated;
 };
 
 struct CallFunctionMessage
@@ -683,6 +704,8 @@ struct CallFunctionMessage
     uint32_t index;
     int argc;
     uintptr_t argv[64];
+    bool pure;
+    bool decode;
 };
 
 struct UseItemMessage
@@ -724,6 +747,142 @@ struct GetSignatureMessage
     int32_t result;
 };
 
+struct FindMethodMessage
+{
+    MessageType type = MessageType::FIND_METHOD;
+    uintptr_t object;
+    bool method_name;
+    char name[0x100];
+    char signature[0x100];
+
+    int32_t result;
+};
+
+struct FindMethodPatternMessage
+{
+    MessageType type = MessageType::FIND_METHOD_PATTERN;
+    uintptr_t object;
+    char pattern[0x300];
+
+    int32_t result;
+};
+
+struct GetLayoutMessage
+{
+    MessageType type = MessageType::GET_LAYOUT;
+    uintptr_t object;
+    char class_name[0x100];
+
+    uint32_t size;
+};
+
+struct RegisterScriptMessage
+{
+    MessageType type = MessageType::REGISTER_SCRIPT;
+    uint32_t count;
+    uint64_t roots[4];
+
+    int32_t result;
+};
+
+struct UnregisterScriptMessage
+{
+    MessageType type = MessageType::UNREGISTER_SCRIPT;
+    int32_t id;
+
+    bool result;
+};
+
+struct RegisterReadsMessage
+{
+    MessageType type = MessageType::REGISTER_READS;
+    uint32_t count;
+
+    int32_t result;
+};
+
+struct UnregisterReadsMessage
+{
+    MessageType type = MessageType::UNREGISTER_READS;
+    int32_t id;
+
+    bool result;
+};
+
+struct CallCacheStatsMessage
+{
+    MessageType type = MessageType::CALL_CACHE_STATS;
+    bool reset;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncached;
+};
+
+// objects, values (set only) and null terminated names follow the message
+struct BulkPropertyMessage
+{
+    MessageType type = MessageType::BULK_PROPERTY;
+    bool set;
+    uint32_t object_count;
+    uint32_t name_count;
+    uint32_t names_size;
+
+    bool result;
+};
+
+// SignatureEntry array and null terminated signatures follow the message
+struct CheckSignaturesMessage
+{
+    MessageType type = MessageType::CHECK_SIGNATURES;
+    uint32_t count;
+    uint32_t signatures_size;
+
+    bool result;
+};
+
+// null terminated class names follow the message
+struct FinddefMessage
+{
+    MessageType type = MessageType::FINDDEF;
+    uint32_t count;
+    uint32_t names_size;
+
+    bool result;
+};
+
+struct SignatureEntry
+{
+    uint64_t object;
+    uint32_t index;
+    uint8_t method_name;
+    uint8_t reserved[3];
+};
+
+struct TickReadEntry
+{
+    uint64_t address;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// Frame layout of do_lib's TickArea
+struct TickHeader
+{
+    std::atomic<uint32_t> sequence;
+    uint32_t tick;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+struct TickRecord
+{
+    uint32_t id;
+    uint32_t flags;     // BotClient::RecordFlags
+    uint32_t size;
+    uint32_t kind;      // TickRecordKind
+};
+
 union Message
 {
     Message() { };
@@ -736,8 +895,21 @@ union Message
     KeyClickMessage key;
     MouseClickMessage click;
     GetSignatureMessage sig;
+    FindMethodMessage find_method;
+    GetLayoutMessage layout;
+    RegisterScriptMessage register_script;
+    UnregisterScriptMessage unregister_script;
+    RegisterReadsMessage register_reads;
+    UnregisterReadsMessage unregister_reads;
+    CallCacheStatsMessage cache_stats;
+    BulkPropertyMessage bulk_property;
+    CheckSignaturesMessage check_signatures;
+    FinddefMessage finddef;
+    FindMethodPatternMessage find_method_pattern;
 };
 
+static_assert(sizeof(Message) < MESSAGE_SIZE, "Message is larger than the allocated shared memory");
+
 BotClient::BotClient() : m_browser_ipc(new SockIpc()) {}
 
 void BotClient::ToggleBrowserVisibility(bool visible)
@@ -1044,16 +1216,8 @@ bool BotClient::IsValid()
     return true;
 }
 
-/**
- * Sends a command message to the flash process via shared memory and semaphores, and optionally waits for a response.
- */
-bool BotClient::SendFlashCommand(Message *message, Message *response)
+bool BotClient::AttachFlashMemory()
 {
-    if (!IsValid())
-    {
-        return false;
-    }
-
     if ((m_flash_shmid = shmget(FlashPid(), MEM_SIZE, IPC_CREAT | 0666)) < 0)
     {
         fprintf(stderr, "[SendFlashCommand] Failed to get shared memory\n");
@@ -1068,6 +1232,30 @@ bool BotClient::SendFlashCommand(Message *message, Message *response)
             return false;
         }
     }
+    return true;
+}
+
+/**
+ * Sends a command message to the flash process via shared memory and semaphores, and optionally waits for a response.
+ * The payload (if any) is written after the message.
+ */
+bool BotClient::SendFlashCommand(Message *message, Message *response, const void *payload, size_t payload_size)
+{
+    if (!IsValid())
+    {
+        return false;
+    }
+
+    if (!AttachFlashMemory())
+    {
+        return false;
+    }
+
+    if (payload_size > TICK_OFFSET - MESSAGE_SIZE)
+    {
+        fprintf(stderr, "[SendFlashCommand] Payload too large\n");
+        return false;
+    }
 
     if (m_flash_sem < 0)
     {
@@ -1080,6 +1268,10 @@ bool BotClient::SendFlashCommand(Message *message, Message *response)
     }
 
 
+    if (payload_size)
+    {
+        std::memcpy(reinterpret_cast<char *>(m_shared_mem_flash) + MESSAGE_SIZE, payload, payload_size);
+    }
     *m_shared_mem_flash = *message;
 
     static timespec timeout { .tv_sec = 1, .tv_nsec = 0 };
@@ -1162,13 +1354,15 @@ bool BotClient::UseItem(const std::string &name, uint8_t type, uint8_t bar)
     return true;
 }
 
-uintptr_t BotClient::CallMethod(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args)
+uintptr_t BotClient::CallMethod(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args, bool pure)
 {
     Message message;
     message.type = MessageType::CALL;
 
     message.call.object = obj;
     message.call.index = index;
+    message.call.pure = pure;
+    message.call.decode = false;
     size_t cap = sizeof(message.call.argv) / sizeof(message.call.argv[0]);
     size_t to_copy = std::min(args.size(), cap);
     message.call.argc = to_copy;
@@ -1182,6 +1376,60 @@ uintptr_t BotClient::CallMethod(uintptr_t obj, uint32_t index, const std::vector
     return response.result.value;
 }
 
+CallResult BotClient::CallMethodDecoded(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args)
+{
+    Message message;
+    message.type = MessageType::CALL;
+
+    message.call.object = obj;
+    message.call.index = index;
+    message.call.pure = false;
+    message.call.decode = true;
+    size_t cap = sizeof(message.call.argv) / sizeof(message.call.argv[0]);
+    size_t to_copy = std::min(args.size(), cap);
+    message.call.argc = to_copy;
+    if (to_copy)
+        memcpy(message.call.argv, args.data(), to_copy * sizeof(uintptr_t));
+
+    CallResult result;
+
+    Message response;
+    if (!SendFlashCommand(&message, &response) || response.result.error)
+    {
+        return result;
+    }
+
+    result.ok = true;
+    result.type = static_cast<CallResult::Type>(response.result.value_type);
+    result.value = response.result.value;
+
+    if (result.type == CallResult::STRING)
+    {
+        size_t size = std::min<size_t>(response.result.string_size, TICK_OFFSET - MESSAGE_SIZE);
+        result.string.assign(reinterpret_cast<const char *>(m_shared_mem_flash) + MESSAGE_SIZE, size);
+        result.truncated = response.result.truncated;
+    }
+    return result;
+}
+
+bool BotClient::GetCallCacheStats(uint64_t &hits, uint64_t &misses, uint64_t &uncached, bool reset)
+{
+    Message message;
+    message.type = MessageType::CALL_CACHE_STATS;
+    message.cache_stats.reset = reset;
+
+    Message response;
+    if (!SendFlashCommand(&message, &response))
+    {
+        return false;
+    }
+
+    hits = response.cache_stats.hits;
+    misses = response.cache_stats.misses;
+    uncached = response.cache_stats.uncached;
+    return true;
+}
+
 /**
  * Sends a key click event to the flash process via shared memory and semaphores.
  *
@@ -1426,6 +1674,570 @@ int BotClient::CheckMethodSignature(uintptr_t object, uint32_t index, bool check
     return response.sig.result;
 }
 
+bool BotClient::CheckMethodSignatures(const std::vector<SignatureQuery> &queries, std::vector<int32_t> &results)
+{
+    constexpr size_t max_payload = TICK_OFFSET - MESSAGE_SIZE;
+    results.assign(queries.size(), -1);
+
+    for (size_t first = 0; first < queries.size(); )
+    {
+        // as many queries as fit, entries first and the signatures after them
+        size_t count = 0, signatures_size = 0;
+        while (first + count < queries.size())
+        {
+            size_t size = queries[first + count].signature.size() + 1;
+            if ((count + 1) * sizeof(SignatureEntry) + signatures_size + size > max_payload)
+            {
+                break;
+            }
+            signatures_size += size;
+            count++;
+        }
+
+        if (count == 0)
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> payload(count * sizeof(SignatureEntry));
+        for (size_t i = 0; i < count; i++)
+        {
+            const SignatureQuery &query = queries[first + i];
+            SignatureEntry entry { query.object, query.index, query.check_name, { } };
+            std::memcpy(&payload[i * sizeof(SignatureEntry)], &entry, sizeof(entry));
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            const std::string &sig = queries[first + i].signature;
+            payload.insert(payload.end(), sig.begin(), sig.end());
+            payload.push_back('\0');
+        }
+
+        Message message;
+        message.type = MessageType::CHECK_SIGNATURES;
+        message.check_signatures.count = count;
+        message.check_signatures.signatures_size = signatures_size;
+
+        Message response;
+        if (!SendFlashCommand(&message, &response, payload.data(), payload.size()) || !response.check_signatures.result)
+        {
+            return false;
+        }
+
+        std::memcpy(&results[first], reinterpret_cast<const uint8_t *>(m_shared_mem_flash) + MESSAGE_SIZE,
+                    count * sizeof(int32_t));
+        first += count;
+    }
+
+    return true;
+}
+
+int BotClient::FindMethod(uintptr_t object, const std::string &name, bool check_name, const std::string &sig)
+{
+    Message message;
+    message.type = MessageType::FIND_METHOD;
+    message.find_method.object = object;
+    message.find_method.method_name = check_name;
+
+    strncpy(message.find_method.name, name.c_str(), sizeof(message.find_method.name));
+    message.find_method.name[sizeof(message.find_method.name) - 1] = '\0';
+    strncpy(message.find_method.signature, sig.c_str(), sizeof(message.find_method.signature));
+    message.find_method.signature[sizeof(message.find_method.signature) - 1] = '\0';
+
+    Message response;
+    SendFlashCommand(&message, &response);
+
+    return response.find_method.result;
+}
+
+int BotClient::FindMethodByPattern(uintptr_t object, const std::string &pattern)
+{
+    Message message;
+    message.type = MessageType::FIND_METHOD_PATTERN;
+    message.find_method_pattern.object = object;
+
+    if (pattern.size() >= sizeof(message.find_method_pattern.pattern))
+    {
+        return -1;
+    }
+    strncpy(message.find_method_pattern.pattern, pattern.c_str(), sizeof(message.find_method_pattern.pattern));
+
+    Message response;
+    if (!SendFlashCommand(&message, &response))
+    {
+        return -1;
+    }
+    return response.find_method_pattern.result;
+}
+
+std::string BotClient::GetLayout(uintptr_t object, const std::string &class_name)
+{
+    Message message;
+    message.type = MessageType::GET_LAYOUT;
+    message.layout.object = object;
+
+    strncpy(message.layout.class_name, class_name.c_str(), sizeof(message.layout.class_name));
+    message.layout.class_name[sizeof(message.layout.class_name) - 1] = '\0';
+
+    Message response;
+    if (!SendFlashCommand(&message, &response) || response.layout.size == 0
+            || response.layout.size > TICK_OFFSET - MESSAGE_SIZE)
+    {
+        return std::string();
+    }
+
+    return std::string(reinterpret_cast<const char *>(m_shared_mem_flash) + MESSAGE_SIZE, response.layout.size);
+}
+
+bool BotClient::Finddef(const std::vector<std::string> &names, std::vector<uintptr_t> &closures)
+{
+    constexpr size_t max_payload = TICK_OFFSET - MESSAGE_SIZE;
+    closures.assign(names.size(), 0);
+
+    for (size_t first = 0; first < names.size(); )
+    {
+        // as many names as fit, the closures come back in their place
+        size_t count = 0;
+        std::vector<uint8_t> payload;
+        while (first + count < names.size())
+        {
+            const std::string &name = names[first + count];
+            if (payload.size() + name.size() + 1 > max_payload || (count + 1) * sizeof(uint64_t) > max_payload)
+            {
+                break;
+            }
+            payload.insert(payload.end(), name.begin(), name.end());
+            payload.push_back('\0');
+            count++;
+        }
+
+        if (count == 0)
+        {
+            return false;
+        }
+
+        Message message;
+        message.type = MessageType::FINDDEF;
+        message.finddef.count = count;
+        message.finddef.names_size = payload.size();
+
+        Message response;
+        if (!SendFlashCommand(&message, &response, payload.data(), payload.size()) || !response.finddef.result)
+        {
+            return false;
+        }
+
+        auto *result = reinterpret_cast<const uint8_t *>(m_shared_mem_flash) + MESSAGE_SIZE;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t address;
+            std::memcpy(&address, result + i * sizeof(uint64_t), sizeof(address));
+            closures[first + i] = address;
+        }
+        first += count;
+    }
+
+    return true;
+}
+
+bool BotClient::BulkProperty(bool set, const std::vector<uintptr_t> &objects, const std::vector<std::string> &names,
+                             std::vector<uint64_t> &values)
+{
+    size_t value_count = objects.size() * names.size();
+    if (value_count == 0 || (set && values.size() != value_count)
+            || value_count * sizeof(uint64_t) > TICK_OFFSET - MESSAGE_SIZE)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> payload(objects.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        uint64_t object = objects[i];
+        std::memcpy(&payload[i * sizeof(uint64_t)], &object, sizeof(object));
+    }
+    if (set)
+    {
+        auto *data = reinterpret_cast<const uint8_t *>(values.data());
+        payload.insert(payload.end(), data, data + value_count * sizeof(uint64_t));
+    }
+
+    size_t names_start = payload.size();
+    for (const auto &name : names)
+    {
+        payload.insert(payload.end(), name.begin(), name.end());
+        payload.push_back('\0');
+    }
+
+    Message message;
+    message.type = MessageType::BULK_PROPERTY;
+    message.bulk_property.set = set;
+    message.bulk_property.object_count = objects.size();
+    message.bulk_property.name_count = names.size();
+    message.bulk_property.names_size = payload.size() - names_start;
+
+    Message response;
+    if (!SendFlashCommand(&message, &response, payload.data(), payload.size()) || !response.bulk_property.result)
+    {
+        return false;
+    }
+
+    values.resize(value_count);
+    std::memcpy(values.data(), reinterpret_cast<const uint8_t *>(m_shared_mem_flash) + MESSAGE_SIZE,
+                value_count * sizeof(uint64_t));
+    return true;
+}
+
+bool BotClient::GetProperties(const std::vector<uintptr_t> &objects, const std::vector<std::string> &names,
+                              std::vector<uint64_t> &values)
+{
+    return BulkProperty(false, objects, names, values);
+}
+
+bool BotClient::SetProperties(const std::vector<uintptr_t> &objects, const std::vector<std::string> &names,
+                              const std::vector<uint64_t> &values, std::vector<bool> &set)
+{
+    std::vector<uint64_t> result = values;
+    if (!BulkProperty(true, objects, names, result))
+    {
+        return false;
+    }
+
+    set.assign(result.size(), false);
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        set[i] = result[i] != 0;
+    }
+    return true;
+}
+
+int BotClient::RegisterScript(const std::vector<uint64_t> &code, const std::vector<uint64_t> &roots)
+{
+    Message message;
+    message.type = MessageType::REGISTER_SCRIPT;
+    message.register_script.count = code.size();
+
+    constexpr size_t max_roots = sizeof(message.register_script.roots) / sizeof(message.register_script.roots[0]);
+    for (size_t i = 0; i < max_roots; i++)
+    {
+        message.register_script.roots[i] = (i < roots.size()) ? roots[i] : 0;
+    }
+
+    Message response;
+    if (code.empty() || !SendFlashCommand(&message, &response, code.data(), code.size() * sizeof(uint64_t)))
+    {
+        return -1;
+    }
+    return response.register_script.result;
+}
+
+bool BotClient::UnregisterScript(int id)
+{
+    Message message;
+    message.type = MessageType::UNREGISTER_SCRIPT;
+    message.unregister_script.id = id;
+
+    Message response;
+    return SendFlashCommand(&message, &response) && response.unregister_script.result;
+}
+
+bool BotClient::ReadTickFrame(std::vector<uint8_t> &records, uint32_t *tick)
+{
+    if ((!m_shared_mem_flash || m_shared_mem_flash == (void *)-1) && (!IsValid() || !AttachFlashMemory()))
+    {
+        return false;
+    }
+
+    auto *area = reinterpret_cast<const uint8_t *>(m_shared_mem_flash) + TICK_OFFSET;
+    auto *header = reinterpret_cast<const TickHeader *>(area);
+
+    // sequence lock: odd while flash writes, changed if a new frame started during the copy
+    for (int attempt = 0; attempt < 1000; attempt++)
+    {
+        uint32_t sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+        {
+            continue;
+        }
+
+        uint32_t size = std::min<uint32_t>(header->size, TICK_SIZE - sizeof(TickHeader));
+        uint32_t frame_tick = header->tick;
+        records.assign(area + sizeof(TickHeader), area + sizeof(TickHeader) + size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            if (tick)
+            {
+                *tick = frame_tick;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+int BotClient::RegisterReads(const std::vector<std::pair<uintptr_t, uint32_t>> &reads)
+{
+    std::vector<TickReadEntry> entries(reads.size());
+    for (size_t i = 0; i < reads.size(); i++)
+    {
+        entries[i] = { reads[i].first, reads[i].second, 0 };
+    }
+
+    Message message;
+    message.type = MessageType::REGISTER_READS;
+    message.register_reads.count = entries.size();
+
+    Message response;
+    if (entries.empty() || !SendFlashCommand(&message, &response, entries.data(), entries.size() * sizeof(TickReadEntry)))
+    {
+        return -1;
+    }
+    return response.register_reads.result;
+}
+
+bool BotClient::UnregisterReads(int id)
+{
+    Message message;
+    message.type = MessageType::UNREGISTER_READS;
+    message.unregister_reads.id = id;
+
+    Message response;
+    return SendFlashCommand(&message, &response) && response.unregister_reads.result;
+}
+
+bool BotClient::ReadScriptResult(int id, std::vector<uint8_t> &data, uint32_t *flags)
+{
+    return ReadTickRecord(TickRecordKind::SCRIPT, id, data, flags);
+}
+
+bool BotClient::ReadRegisteredReads(int id, std::vector<uint8_t> &data, uint32_t *flags)
+{
+    return ReadTickRecord(TickRecordKind::READ_SET, id, data, flags);
+}
+
+bool BotClient::ReadTickRecord(TickRecordKind kind, int id, std::vector<uint8_t> &data, uint32_t *flags)
+{
+    std::vector<uint8_t> records;
+    if (!ReadTickFrame(records))
+    {
+        return false;
+    }
+
+    for (size_t pos = 0; pos + sizeof(TickRecord) <= records.size(); )
+    {
+        TickRecord record;
+        std::memcpy(&record, &records[pos], sizeof(record));
+        pos += sizeof(TickRecord);
+
+        if (record.size > records.size() - pos)
+        {
+            break;
+        }
+
+        if (record.id == static_cast<uint32_t>(id) && record.kind == static_cast<uint32_t>(kind))
+        {
+            data.assign(records.begin() + pos, records.begin() + pos + record.size);
+            if (flags)
+            {
+                *flags = record.flags;
+            }
+            return true;
+        }
+        pos += (record.size + 7) & ~7U;
+    }
+    return false;
+}
+
+std::vector<std::string> BotClient::ReadStrings(const std::vector<uintptr_t> &addresses, std::vector<bool> *valid)
+{
+    // avm::String fields from data (0x10) to flags (0x24)
+    struct StringHeader
+    {
+        uintptr_t data;     // or byte offset into the master buffer for dependent strings
+        uintptr_t extra;    // master of dependent strings
+        uint32_t size;
+        uint32_t flags;
+
+        inline bool wide() const { return flags & 1; }
+        inline bool dependent() const { return flags & (2 << 1); }
+    };
+
+    constexpr uint32_t MAX_CHARS = 0x10000;
+
+    size_t count = addresses.size();
+    std::vector<std::string> result(count);
+    std::vector<StringHeader> headers(count);
+    std::vector<ProcUtil::ReadOp> ops(count);
+
+    if (valid)
+    {
+        valid->assign(count, false);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ops[i] = { addresses[i] + 0x10, &headers[i], sizeof(StringHeader), false };
+    }
+    ProcUtil::ReadMemoryBatch(m_flash_pid, ops.data(), count);
+
+    std::vector<bool> ok(count);
+    std::vector<size_t> dependent;
+    for (size_t i = 0; i < count; i++)
+    {
+        ok[i] = addresses[i] && ops[i].ok && headers[i].size <= MAX_CHARS;
+        if (ok[i] && headers[i].dependent())
+        {
+            dependent.push_back(i);
+        }
+    }
+
+    // dependent strings point into their master's buffer
+    if (!dependent.empty())
+    {
+        std::vector<uintptr_t> master_data(dependent.size());
+        std::vector<ProcUtil::ReadOp> master_ops(dependent.size());
+        for (size_t j = 0; j < dependent.size(); j++)
+        {
+            master_ops[j] = { headers[dependent[j]].extra + 0x10, &master_data[j], sizeof(uintptr_t), false };
+        }
+        ProcUtil::ReadMemoryBatch(m_flash_pid, master_ops.data(), master_ops.size());
+
+        for (size_t j = 0; j < dependent.size(); j++)
+        {
+            size_t i = dependent[j];
+            ok[i] = master_ops[j].ok;
+            headers[i].data = master_data[j] + headers[i].data;
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> buffers(count);
+    ops.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ok[i])
+        {
+            buffers[i].resize(static_cast<size_t>(headers[i].size) << (headers[i].wide() ? 1 : 0));
+            ops.push_back({ headers[i].data, buffers[i].data(), buffers[i].size(), false });
+        }
+    }
+    ProcUtil::ReadMemoryBatch(m_flash_pid, ops.data(), ops.size());
+
+    for (size_t i = 0, op = 0; i < count; i++)
+    {
+        if (!ok[i] || !ops[op++].ok)
+        {
+            continue;
+        }
+
+        if (headers[i].wide())
+        {
+            result[i] = utf::from_utf16(reinterpret_cast<const char16_t *>(buffers[i].data()), headers[i].size);
+        }
+        else
+        {
+            result[i] = utf::from_latin1(buffers[i].data(), headers[i].size);
+        }
+
+        if (valid)
+        {
+            (*valid)[i] = true;
+        }
+    }
+    return result;
+}
+
+std::vector<uint64_t> BotClient::ReadCollection(uintptr_t collection, bool vector, const std::vector<uint32_t> &field_offsets)
+{
+    // same layout as avm::ARRAY_LAYOUT / avm::VECTOR_LAYOUT in do_lib
+    constexpr uint32_t MAX_ELEMENTS = 0x10000;
+
+    struct CollectionHeader
+    {
+        uintptr_t buffer;
+        uint32_t size;
+    };
+
+    CollectionHeader header;
+    uintptr_t header_address = collection + (vector ? 0x30 : 0x20);
+    if (!collection || ProcUtil::ReadMemoryBytes(m_flash_pid, header_address, &header, sizeof(header)) != sizeof(header)
+        || !header.buffer || header.size > MAX_ELEMENTS)
+    {
+        return { };
+    }
+
+    std::vector<uintptr_t> elements(header.size);
+    size_t bytes = elements.size() * sizeof(uintptr_t);
+    if (bytes && ProcUtil::ReadMemoryBytes(m_flash_pid, header.buffer + 0x10, elements.data(), bytes) != bytes)
+    {
+        return { };
+    }
+
+    size_t width = 1 + field_offsets.size();
+    std::vector<uint64_t> result(elements.size() * width, 0);
+    std::vector<ProcUtil::ReadOp> ops;
+    ops.reserve(elements.size() * field_offsets.size());
+
+    for (size_t i = 0; i < elements.size(); i++)
+    {
+        uintptr_t element = elements[i] & ~7;
+        result[i * width] = element;
+
+        if (!element)
+        {
+            continue;
+        }
+
+        for (size_t f = 0; f < field_offsets.size(); f++)
+        {
+            ops.push_back({ element + field_offsets[f], &result[i * width + 1 + f], sizeof(uint64_t), false });
+        }
+    }
+
+    ProcUtil::ReadMemoryBatch(m_flash_pid, ops.data(), ops.size());
+    for (auto &op : ops)
+    {
+        if (!op.ok)
+        {
+            *static_cast<uint64_t *>(op.dest) = 0;
+        }
+    }
+    return result;
+}
+
+std::vector<ShipInfo> BotClient::ReadShips(const std::vector<uintptr_t> &addresses)
+{
+    using namespace layouts;
+
+    size_t count = addresses.size();
+    std::vector<RemoteView<Ship::View>> ships(count);
+    std::vector<RemoteView<LocationInfo::View>> locations(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ships[i].address = addresses[i];
+    }
+
+    ReadViews(m_flash_pid, ships.data(), count);
+    ReadNested<Ship::LocationInfo>(m_flash_pid, ships.data(), locations.data(), count);
+
+    std::vector<ShipInfo> result(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto &ship = ships[i];
+        auto &location = locations[i];
+
+        result[i].address = addresses[i];
+        result[i].ok = ship.ok;
+        result[i].id = ship.ok ? ship.get<Ship::Id>() : 0;
+        result[i].visible = ship.ok && ship.get<Ship::Visible>();
+        result[i].x = location.ok ? location.get<LocationInfo::X>() : -1;
+        result[i].y = location.ok ? location.get<LocationInfo::Y>() : -1;
+    }
+    return result;
+}
+
 void BotClient::EnableCursorMarker(bool enable)
 {
     if (enable == cursor_marker::state.enabled)
@@ -1,6 +1,7 @@
 #ifndef BOT_CLIENT_H
 #define BOT_CLIENT_H
 #include <memory>
+#include <cstring>
 #include <mutex>
 #include <initializer_list>
 #include <string>
@@ -19,6 +20,52 @@ struct JsonParam
     std::string_view value;
 };
 
+// Typed result of BotClient::CallMethodDecoded, types match do_lib's Darkorbit::CallValue
+struct CallResult
+{
+    enum Type : uint8_t
+    {
+        UNDEFINED,
+        NULL_VALUE,
+        BOOLEAN,
+        INT,
+        UINT,
+        NUMBER,
+        STRING,
+        OBJECT
+    };
+
+    bool ok = false;
+    Type type = UNDEFINED;
+    uint64_t value = 0;     // integer, double bits or the object / string pointer
+    std::string string;     // utf-8
+    bool truncated = false; // string was cut at a character boundary to fit the shared memory
+
+    inline double number() const
+    {
+        double d;
+        std::memcpy(&d, &value, sizeof(d));
+        return d;
+    }
+};
+
+struct ShipInfo
+{
+    uintptr_t address;
+    uint32_t id;
+    bool visible;
+    double x, y;
+    bool ok;
+};
+
+struct SignatureQuery
+{
+    uintptr_t object;
+    uint32_t index;
+    bool check_name;
+    std::string signature;
+};
+
 class BotClient
 {
 public:
@@ -45,12 +92,16 @@ public:
     void ToggleBrowserVisibility(bool visible);
 
     // returns true if the command was successfully processed by flash
-    bool SendFlashCommand(Message *message, Message *response = nullptr);
+    bool SendFlashCommand(Message *message, Message *response = nullptr, const void *payload = nullptr, size_t payload_size = 0);
 
     bool RefineOre(uintptr_t refine_util, uint32_t ore, uint32_t amount);
     bool SendNotification(uintptr_t screen_manager, const std::string &name, const std::vector<uintptr_t> &args);
     bool UseItem(const std::string &name, uint8_t type, uint8_t bar);
-    uintptr_t CallMethod(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args);
+    // pure: the method has no side effects, do_lib may answer from the results of this tick
+    uintptr_t CallMethod(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args, bool pure = false);
+    // Decodes the result on the flash thread by the method's return type, strings included
+    CallResult CallMethodDecoded(uintptr_t obj, uint32_t index, const std::vector<uintptr_t> &args);
+    bool GetCallCacheStats(uint64_t &hits, uint64_t &misses, uint64_t &uncached, bool reset);
     bool KeyClickLegacy(uint32_t key);
     void KeyClick(uint32_t key);
     void KeyDown(uint32_t key);
@@ -63,6 +114,64 @@ public:
     void MouseUp(int32_t x, int32_t y);
     void MouseScroll(int32_t x, int32_t y, int32_t delta);
     int CheckMethodSignature(uintptr_t object, uint32_t index, bool check_name, const std::string &sig);
+    // CheckMethodSignature for all of them, as few round trips as fit in the shared memory
+    bool CheckMethodSignatures(const std::vector<SignatureQuery> &queries, std::vector<int32_t> &results);
+    // vtable slot of a method by name (and signature if not empty), -1 if not found
+    int FindMethod(uintptr_t object, const std::string &name, bool check_name, const std::string &sig);
+    // vtable slot of the first method whose bytecode matches the pattern, -1 if none. The syntax is
+    // do_lib's BytecodePattern: "getlex ? ; * ; callproperty 85 0 ; ?? ; returnvoid"
+    int FindMethodByPattern(uintptr_t object, const std::string &pattern);
+    // Slot layout of the object's class, or of the named class if object is 0, as json:
+    // {"name":..., "slots":[{"name":..., "offset":..., "storage":..., "type":...}]}. Empty if not found.
+    std::string GetLayout(uintptr_t object, const std::string &class_name);
+    // Class closures of the game's definitions by name (0 if not found), as few round trips as fit
+    bool Finddef(const std::vector<std::string> &names, std::vector<uintptr_t> &closures);
+
+    // Every name of every object in one round trip, values are object major (objects.size() * names.size()).
+    // Get returns the raw atoms, undefined (4) for names the object's class does not declare. Dynamic
+    // properties (Object, Dictionary, dynamic classes) only resolve if the game's constant pool has
+    // their name as a public qname.
+    bool GetProperties(const std::vector<uintptr_t> &objects, const std::vector<std::string> &names, std::vector<uint64_t> &values);
+    // Sets values (atoms, object major), set tells which ones were written
+    bool SetProperties(const std::vector<uintptr_t> &objects, const std::vector<std::string> &names,
+                       const std::vector<uint64_t> &values, std::vector<bool> &set);
+
+    // Read scripts run by do_lib every tick, see do_lib/read_script.h for the instruction
+    // encoding (one 64 bit word each). Returns the script id or -1.
+    int RegisterScript(const std::vector<uint64_t> &code, const std::vector<uint64_t> &roots);
+    bool UnregisterScript(int id);
+
+    // Copies the records of the latest tick frame out of shared memory, no syscalls once attached
+    bool ReadTickFrame(std::vector<uint8_t> &records, uint32_t *tick = nullptr);
+    // Output of a registered script in the latest frame, false if it is not in there
+    bool ReadScriptResult(int id, std::vector<uint8_t> &data, uint32_t *flags = nullptr);
+
+    // flags of a tick record, same values as the read_script result flags in do_lib
+    enum RecordFlags : uint32_t
+    {
+        RECORD_FAULTED      = 1,
+        RECORD_TRUNCATED    = 2,    // the record holds no or cut off data
+        RECORD_SKIPPED      = 4
+    };
+
+    // Fixed (address, size) reads that do_lib copies into the frame at the end of every tick
+    int RegisterReads(const std::vector<std::pair<uintptr_t, uint32_t>> &reads);
+    bool UnregisterReads(int id);
+    // A bitmap of the reads that succeeded (padded to 8 bytes), then the bytes of every read in order
+    bool ReadRegisteredReads(int id, std::vector<uint8_t> &data, uint32_t *flags = nullptr);
+
+    // Decodes avm::String objects of the flash process to utf-8 with batched reads:
+    // headers, masters of dependent strings (only if there are any), then the characters.
+    // valid (if given) marks the strings that could be read, the others are empty.
+    std::vector<std::string> ReadStrings(const std::vector<uintptr_t> &addresses, std::vector<bool> *valid = nullptr);
+
+    // Elements of an avm Array (vector = false) or Vector.<*> with their atom tag removed,
+    // each followed by the 8 byte values at field_offsets of that element (0 if unreadable).
+    // Rows are 1 + field_offsets.size() values wide.
+    std::vector<uint64_t> ReadCollection(uintptr_t collection, bool vector, const std::vector<uint32_t> &field_offsets);
+
+    // Ships read through layouts::Ship in two batched reads: the ships, then their locations
+    std::vector<ShipInfo> ReadShips(const std::vector<uintptr_t> &addresses);
 
     // batch processing of native actions coming from the Java layer
     void PostActions(const std::vector<uint64_t> &actions);
@@ -130,6 +239,17 @@ public:
 
 
 private:
+    enum class TickRecordKind : uint32_t
+    {
+        SCRIPT,
+        READ_SET
+    };
+
+    bool AttachFlashMemory();
+    bool ReadTickRecord(TickRecordKind kind, int id, std::vector<uint8_t> &data, uint32_t *flags);
+    bool BulkProperty(bool set, const std::vector<uintptr_t> &objects, const std::vector<std::string> &names,
+                      std::vector<uint64_t> &values);
+
     std::unique_ptr<SockIpc> m_browser_ipc;
     char *m_shared_mem = nullptr;
     Message *m_shared_mem_flash = nullptr;
@@ -1,14 +1,29 @@
 
 #include "eu_darkbot_api_DarkTanos.h"
+#include <cstdarg>
 #include <unistd.h>
 #include <cstring>
 #include <vector>
 
 #include "bot_client.h"
+#include "utf.h"
 #include "utils.h"
 
 static BotClient client;
 
+// NewStringUTF expects modified utf-8, anything beyond ascii goes through utf-16
+static jstring new_jstring(JNIEnv *env, const std::string &s)
+{
+    if (utf::ascii_prefix(reinterpret_cast<const uint8_t *>(s.data()), s.size()) == s.size()
+        && s.find('\0') == std::string::npos)
+    {
+        return env->NewStringUTF(s.c_str());
+    }
+
+    std::u16string wide = utf::to_utf16(s);
+    return env->NewString(reinterpret_cast<const jchar *>(wide.data()), wide.size());
+}
+
 
 JNIEXPORT void JNICALL Java_eu_darkbot_api_DarkTanos_setData
   (JNIEnv *env, jobject, jstring jurl, jstring jsid, jstring preloader, jstring vars)
@@ -341,6 +356,83 @@ JNIEXPORT jlong JNICALL Java_eu_darkbot_api_DarkTanos_callMethod
     return client.CallMethod(jthis, jindex, args);
 }
 
+// Same as callMethod, repeated calls within one tick are answered from do_lib's cache
+JNIEXPORT jlong JNICALL Java_eu_darkbot_api_DarkTanos_callPureMethod
+  (JNIEnv *env, jobject, jlong jthis, jint jindex, jlongArray jargs)
+{
+    std::vector<uintptr_t> args(jargs ? env->GetArrayLength(jargs) : 0);
+    if (!args.empty())
+    {
+        env->GetLongArrayRegion(jargs, 0, args.size(), reinterpret_cast<jlong *>(args.data()));
+    }
+    return client.CallMethod(jthis, jindex, args, true);
+}
+
+// { hits, misses, uncached } or null if flash did not answer
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_getCallCacheStats
+  (JNIEnv *env, jobject, jboolean reset)
+{
+    uint64_t hits = 0, misses = 0, uncached = 0;
+    if (!client.GetCallCacheStats(hits, misses, uncached, reset))
+    {
+        return nullptr;
+    }
+
+    jlong stats[] = { static_cast<jlong>(hits), static_cast<jlong>(misses), static_cast<jlong>(uncached) };
+    jlongArray result = env->NewLongArray(3);
+    env->SetLongArrayRegion(result, 0, 3, stats);
+    return result;
+}
+
+static jobject box(JNIEnv *env, const char *cls, const char *sig, ...)
+{
+    jclass clazz = env->FindClass(cls);
+    jmethodID value_of = env->GetStaticMethodID(clazz, "valueOf", sig);
+
+    va_list args;
+    va_start(args, sig);
+    jobject result = env->CallStaticObjectMethodV(clazz, value_of, args);
+    va_end(args);
+
+    env->DeleteLocalRef(clazz);
+    return result;
+}
+
+// Boolean, Integer (int), Long (uint and object addresses), Double or String.
+// Null for null, undefined, void methods and failed calls.
+JNIEXPORT jobject JNICALL Java_eu_darkbot_api_DarkTanos_callMethodDecoded
+  (JNIEnv *env, jobject, jlong jthis, jint jindex, jlongArray jargs)
+{
+    std::vector<uintptr_t> args(jargs ? env->GetArrayLength(jargs) : 0);
+    if (!args.empty())
+    {
+        env->GetLongArrayRegion(jargs, 0, args.size(), reinterpret_cast<jlong *>(args.data()));
+    }
+
+    CallResult result = client.CallMethodDecoded(jthis, jindex, args);
+    if (!result.ok)
+    {
+        return nullptr;
+    }
+
+    switch (result.type)
+    {
+        case CallResult::BOOLEAN:
+            return box(env, "java/lang/Boolean", "(Z)Ljava/lang/Boolean;", static_cast<jboolean>(result.value != 0));
+        case CallResult::INT:
+            return box(env, "java/lang/Integer", "(I)Ljava/lang/Integer;", static_cast<jint>(result.value));
+        case CallResult::UINT:
+        case CallResult::OBJECT:
+            return box(env, "java/lang/Long", "(J)Ljava/lang/Long;", static_cast<jlong>(result.value));
+        case CallResult::NUMBER:
+            return box(env, "java/lang/Double", "(D)Ljava/lang/Double;", static_cast<jdouble>(result.number()));
+        case CallResult::STRING:
+            return new_jstring(env, result.string);
+        default:
+            return nullptr;
+    }
+}
+
 JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_checkMethodSignature
   (JNIEnv *env, jobject, jlong object, jint index, jboolean check_name, jstring sig)
 {
@@ -353,3 +445,334 @@ JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_checkMethodSignature
     return result;
 }
 
+JNIEXPORT jobjectArray JNICALL Java_eu_darkbot_api_DarkTanos_readStrings
+  (JNIEnv *env, jobject, jlongArray jaddresses)
+{
+    jsize len = jaddresses ? env->GetArrayLength(jaddresses) : 0;
+
+    std::vector<uintptr_t> addresses(len);
+    if (len > 0)
+    {
+        env->GetLongArrayRegion(jaddresses, 0, len, reinterpret_cast<jlong *>(addresses.data()));
+    }
+
+    std::vector<bool> valid;
+    std::vector<std::string> strings = client.ReadStrings(addresses, &valid);
+
+    jobjectArray result = env->NewObjectArray(len, env->FindClass("java/lang/String"), nullptr);
+    for (jsize i = 0; i < len; i++)
+    {
+        if (valid[i])
+        {
+            jstring str = new_jstring(env, strings[i]);
+            env->SetObjectArrayElement(result, i, str);
+            env->DeleteLocalRef(str);
+        }
+    }
+    return result;
+}
+
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_readCollection
+  (JNIEnv *env, jobject, jlong jaddr, jboolean jvector, jintArray joffsets)
+{
+    jsize len = joffsets ? env->GetArrayLength(joffsets) : 0;
+
+    std::vector<uint32_t> offsets(len);
+    if (len > 0)
+    {
+        env->GetIntArrayRegion(joffsets, 0, len, reinterpret_cast<jint *>(offsets.data()));
+    }
+
+    std::vector<uint64_t> rows = client.ReadCollection(jaddr, jvector, offsets);
+
+    jlongArray result = env->NewLongArray(rows.size());
+    if (!rows.empty())
+    {
+        env->SetLongArrayRegion(result, 0, rows.size(), reinterpret_cast<jlong *>(rows.data()));
+    }
+    return result;
+}
+
+JNIEXPORT jstring JNICALL Java_eu_darkbot_api_DarkTanos_getLayout
+  (JNIEnv *env, jobject, jlong object, jstring class_name)
+{
+    std::string name;
+    if (class_name)
+    {
+        const char *name_cstr = env->GetStringUTFChars(class_name, NULL);
+        name = name_cstr;
+        env->ReleaseStringUTFChars(class_name, name_cstr);
+    }
+
+    std::string layout = client.GetLayout(object, name);
+    return layout.empty() ? nullptr : new_jstring(env, layout);
+}
+
+static jbyteArray new_byte_array(JNIEnv *env, const std::vector<uint8_t> &data)
+{
+    jbyteArray result = env->NewByteArray(data.size());
+    if (!data.empty())
+    {
+        env->SetByteArrayRegion(result, 0, data.size(), reinterpret_cast<const jbyte *>(data.data()));
+    }
+    return result;
+}
+
+static std::vector<uint64_t> get_longs(JNIEnv *env, jlongArray array)
+{
+    jsize len = array ? env->GetArrayLength(array) : 0;
+
+    std::vector<uint64_t> values(len);
+    if (len > 0)
+    {
+        env->GetLongArrayRegion(array, 0, len, reinterpret_cast<jlong *>(values.data()));
+    }
+    return values;
+}
+
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_registerScript
+  (JNIEnv *env, jobject, jlongArray code, jlongArray roots)
+{
+    return client.RegisterScript(get_longs(env, code), get_longs(env, roots));
+}
+
+JNIEXPORT jboolean JNICALL Java_eu_darkbot_api_DarkTanos_unregisterScript
+  (JNIEnv *, jobject, jint id)
+{
+    return client.UnregisterScript(id);
+}
+
+// Output of the script in the latest tick, null if it is missing or faulted
+JNIEXPORT jbyteArray JNICALL Java_eu_darkbot_api_DarkTanos_readScriptResult
+  (JNIEnv *env, jobject, jint id)
+{
+    std::vector<uint8_t> data;
+    uint32_t flags = 0;
+
+    if (!client.ReadScriptResult(id, data, &flags) || (flags & BotClient::RECORD_FAULTED))
+    {
+        return nullptr;
+    }
+
+    return new_byte_array(env, data);
+}
+
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_registerReads
+  (JNIEnv *env, jobject, jlongArray addresses, jintArray sizes)
+{
+    std::vector<uint64_t> address_list = get_longs(env, addresses);
+    jsize len = sizes ? env->GetArrayLength(sizes) : 0;
+
+    if (static_cast<size_t>(len) != address_list.size())
+    {
+        return -1;
+    }
+
+    std::vector<jint> size_list(len);
+    if (len > 0)
+    {
+        env->GetIntArrayRegion(sizes, 0, len, size_list.data());
+    }
+
+    std::vector<std::pair<uintptr_t, uint32_t>> reads(len);
+    for (jsize i = 0; i < len; i++)
+    {
+        reads[i] = { address_list[i], static_cast<uint32_t>(size_list[i]) };
+    }
+    return client.RegisterReads(reads);
+}
+
+JNIEXPORT jboolean JNICALL Java_eu_darkbot_api_DarkTanos_unregisterReads
+  (JNIEnv *, jobject, jint id)
+{
+    return client.UnregisterReads(id);
+}
+
+// Bitmap of the reads that succeeded, padded to 8 bytes, then the read bytes. Null if the
+// set is not in the latest frame or did not fit into it.
+JNIEXPORT jbyteArray JNICALL Java_eu_darkbot_api_DarkTanos_readRegisteredReads
+  (JNIEnv *env, jobject, jint id)
+{
+    std::vector<uint8_t> data;
+    uint32_t flags = 0;
+
+    if (!client.ReadRegisteredReads(id, data, &flags) || (flags & BotClient::RECORD_TRUNCATED))
+    {
+        return nullptr;
+    }
+    return new_byte_array(env, data);
+}
+
+// Rows of { id, visible, x, y } per ship, x and y as raw double bits; id is -1 for unreadable ships
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_readShips
+  (JNIEnv *env, jobject, jlongArray jaddresses)
+{
+    jsize len = jaddresses ? env->GetArrayLength(jaddresses) : 0;
+
+    std::vector<uintptr_t> addresses(len);
+    if (len > 0)
+    {
+        env->GetLongArrayRegion(jaddresses, 0, len, reinterpret_cast<jlong *>(addresses.data()));
+    }
+
+    std::vector<ShipInfo> ships = client.ReadShips(addresses);
+
+    std::vector<jlong> rows(ships.size() * 4);
+    for (size_t i = 0; i < ships.size(); i++)
+    {
+        jlong *row = &rows[i * 4];
+        row[0] = ships[i].ok ? static_cast<jlong>(ships[i].id) : -1;
+        row[1] = ships[i].visible;
+        std::memcpy(&row[2], &ships[i].x, sizeof(double));
+        std::memcpy(&row[3], &ships[i].y, sizeof(double));
+    }
+
+    jlongArray result = env->NewLongArray(rows.size());
+    if (!rows.empty())
+    {
+        env->SetLongArrayRegion(result, 0, rows.size(), rows.data());
+    }
+    return result;
+}
+
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_findMethod
+  (JNIEnv *env, jobject, jlong object, jstring name, jboolean check_name, jstring sig)
+{
+    const char *name_cstr = env->GetStringUTFChars(name, NULL);
+    const char *sig_cstr = env->GetStringUTFChars(sig, NULL);
+
+    int result = client.FindMethod(object, name_cstr, check_name, sig_cstr);
+
+    env->ReleaseStringUTFChars(sig, sig_cstr);
+    env->ReleaseStringUTFChars(name, name_cstr);
+
+    return result;
+}
+
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_findMethodByPattern
+  (JNIEnv *env, jobject, jlong object, jstring pattern)
+{
+    const char *pattern_cstr = env->GetStringUTFChars(pattern, NULL);
+
+    int result = client.FindMethodByPattern(object, pattern_cstr);
+
+    env->ReleaseStringUTFChars(pattern, pattern_cstr);
+
+    return result;
+}
+
+
+static std::vector<std::string> get_strings(JNIEnv *env, jobjectArray array)
+{
+    jsize len = array ? env->GetArrayLength(array) : 0;
+
+    std::vector<std::string> strings(len);
+    for (jsize i = 0; i < len; i++)
+    {
+        auto jstr = static_cast<jstring>(env->GetObjectArrayElement(array, i));
+        if (!jstr)
+        {
+            continue;
+        }
+
+        const char *cstr = env->GetStringUTFChars(jstr, NULL);
+        strings[i] = cstr;
+        env->ReleaseStringUTFChars(jstr, cstr);
+        env->DeleteLocalRef(jstr);
+    }
+    return strings;
+}
+
+// objects.length * names.length atoms, object major, or null if flash did not answer
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_getProperties
+  (JNIEnv *env, jobject, jlongArray objects, jobjectArray names)
+{
+    std::vector<uint64_t> addresses = get_longs(env, objects);
+    std::vector<uint64_t> values;
+    if (!client.GetProperties({ addresses.begin(), addresses.end() }, get_strings(env, names), values))
+    {
+        return nullptr;
+    }
+
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), reinterpret_cast<const jlong *>(values.data()));
+    return result;
+}
+
+// Which of the values (object major, like getProperties) were set, or null if flash did not answer
+JNIEXPORT jbooleanArray JNICALL Java_eu_darkbot_api_DarkTanos_setProperties
+  (JNIEnv *env, jobject, jlongArray objects, jobjectArray names, jlongArray values)
+{
+    std::vector<uint64_t> addresses = get_longs(env, objects);
+    std::vector<bool> set;
+    if (!client.SetProperties({ addresses.begin(), addresses.end() }, get_strings(env, names), get_longs(env, values), set))
+    {
+        return nullptr;
+    }
+
+    std::vector<jboolean> flags(set.begin(), set.end());
+    jbooleanArray result = env->NewBooleanArray(flags.size());
+    env->SetBooleanArrayRegion(result, 0, flags.size(), flags.data());
+    return result;
+}
+
+// Same results as checkMethodSignature for every (object, index, check_name, sig), null if flash did not answer
+JNIEXPORT jintArray JNICALL Java_eu_darkbot_api_DarkTanos_checkMethodSignatures
+  (JNIEnv *env, jobject, jlongArray objects, jintArray indexes, jbooleanArray check_names, jobjectArray sigs)
+{
+    std::vector<uint64_t> addresses = get_longs(env, objects);
+    std::vector<std::string> signatures = get_strings(env, sigs);
+    jsize len = static_cast<jsize>(addresses.size());
+
+    if (!indexes || !check_names || env->GetArrayLength(indexes) != len
+            || env->GetArrayLength(check_names) != len || static_cast<jsize>(signatures.size()) != len)
+    {
+        return nullptr;
+    }
+
+    std::vector<jint> index(len);
+    std::vector<jboolean> check_name(len);
+    if (len > 0)
+    {
+        env->GetIntArrayRegion(indexes, 0, len, index.data());
+        env->GetBooleanArrayRegion(check_names, 0, len, check_name.data());
+    }
+
+    std::vector<SignatureQuery> queries(len);
+    for (jsize i = 0; i < len; i++)
+    {
+        queries[i] = { addresses[i], static_cast<uint32_t>(index[i]), check_name[i] != 0, std::move(signatures[i]) };
+    }
+
+    std::vector<int32_t> results;
+    if (!client.CheckMethodSignatures(queries, results))
+    {
+        return nullptr;
+    }
+
+    jintArray result = env->NewIntArray(results.size());
+    if (!results.empty())
+    {
+        env->SetIntArrayRegion(result, 0, results.size(), results.data());
+    }
+    return result;
+}
+
+// Class closure addresses (0 if not found) of the named definitions, null if flash did not answer
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_finddef
+  (JNIEnv *env, jobject, jobjectArray names)
+{
+    std::vector<uintptr_t> closures;
+    if (!client.Finddef(get_strings(env, names), closures))
+    {
+        return nullptr;
+    }
+
+    std::vector<jlong> values(closures.begin(), closures.end());
+    jlongArray result = env->NewLongArray(values.size());
+    if (!values.empty())
+    {
+        env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    }
+    return result;
+}
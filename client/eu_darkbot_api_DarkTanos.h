@@ -335,6 +335,30 @@ JNIEXPORT jboolean JNICALL Java_eu_darkbot_api_DarkTanos_useItem
 JNIEXPORT jlong JNICALL Java_eu_darkbot_api_DarkTanos_callMethod
   (JNIEnv *, jobject, jlong, jint, jlongArray);
 
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    callPureMethod
+ * Signature: (JI[J)J
+ */
+JNIEXPORT jlong JNICALL Java_eu_darkbot_api_DarkTanos_callPureMethod
+  (JNIEnv *, jobject, jlong, jint, jlongArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    getCallCacheStats
+ * Signature: (Z)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_getCallCacheStats
+  (JNIEnv *, jobject, jboolean);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    callMethodDecoded
+ * Signature: (JI[J)Ljava/lang/Object;
+ */
+JNIEXPORT jobject JNICALL Java_eu_darkbot_api_DarkTanos_callMethodDecoded
+  (JNIEnv *, jobject, jlong, jint, jlongArray);
+
 /*
  * Class:     eu_darkbot_api_DarkTanos
  * Method:    checkMethodSignature
@@ -343,6 +367,134 @@ JNIEXPORT jlong JNICALL Java_eu_darkbot_api_DarkTanos_callMethod
 JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_checkMethodSignature
   (JNIEnv *, jobject, jlong, jint, jboolean, jstring);
 
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    findMethod
+ * Signature: (JLjava/lang/String;ZLjava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_findMethod
+  (JNIEnv *, jobject, jlong, jstring, jboolean, jstring);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    findMethodByPattern
+ * Signature: (JLjava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_findMethodByPattern
+  (JNIEnv *, jobject, jlong, jstring);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    readStrings
+ * Signature: ([J)[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_eu_darkbot_api_DarkTanos_readStrings
+  (JNIEnv *, jobject, jlongArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    readCollection
+ * Signature: (JZ[I)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_readCollection
+  (JNIEnv *, jobject, jlong, jboolean, jintArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    readShips
+ * Signature: ([J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_readShips
+  (JNIEnv *, jobject, jlongArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    getLayout
+ * Signature: (JLjava/lang/String;)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_eu_darkbot_api_DarkTanos_getLayout
+  (JNIEnv *, jobject, jlong, jstring);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    registerScript
+ * Signature: ([J[J)I
+ */
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_registerScript
+  (JNIEnv *, jobject, jlongArray, jlongArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    unregisterScript
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_eu_darkbot_api_DarkTanos_unregisterScript
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    readScriptResult
+ * Signature: (I)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_eu_darkbot_api_DarkTanos_readScriptResult
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    registerReads
+ * Signature: ([J[I)I
+ */
+JNIEXPORT jint JNICALL Java_eu_darkbot_api_DarkTanos_registerReads
+  (JNIEnv *, jobject, jlongArray, jintArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    unregisterReads
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_eu_darkbot_api_DarkTanos_unregisterReads
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    readRegisteredReads
+ * Signature: (I)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_eu_darkbot_api_DarkTanos_readRegisteredReads
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    getProperties
+ * Signature: ([J[Ljava/lang/String;)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_getProperties
+  (JNIEnv *, jobject, jlongArray, jobjectArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    setProperties
+ * Signature: ([J[Ljava/lang/String;[J)[Z
+ */
+JNIEXPORT jbooleanArray JNICALL Java_eu_darkbot_api_DarkTanos_setProperties
+  (JNIEnv *, jobject, jlongArray, jobjectArray, jlongArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    checkMethodSignatures
+ * Signature: ([J[I[Z[Ljava/lang/String;)[I
+ */
+JNIEXPORT jintArray JNICALL Java_eu_darkbot_api_DarkTanos_checkMethodSignatures
+  (JNIEnv *, jobject, jlongArray, jintArray, jbooleanArray, jobjectArray);
+
+/*
+ * Class:     eu_darkbot_api_DarkTanos
+ * Method:    finddef
+ * Signature: ([Ljava/lang/String;)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_eu_darkbot_api_DarkTanos_finddef
+  (JNIEnv *, jobject, jobjectArray);
+
 #ifdef __cplusplus
 }
 #endif
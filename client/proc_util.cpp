@@ -6,6 +6,8 @@
 #include <cstring>
 #include "masked_bmh.h"
 
+#include <cerrno>
+#include <climits>
 #include <sys/uio.h>
 #include <unistd.h>
 
@@ -92,6 +94,45 @@ size_t ProcUtil::ReadMemoryBytes(pid_t pid, uintptr_t address, void *dest, uint6
     return process_vm_readv(pid, &local_addr, 1, &remote_addr, 1, 0 );
 }
 
+size_t ProcUtil::ReadMemoryBatch(pid_t pid, ReadOp *ops, size_t count)
+{
+    std::vector<iovec> local(std::min<size_t>(count, IOV_MAX));
+    std::vector<iovec> remote(local.size());
+    size_t read_ops = 0;
+
+    size_t first = 0;
+    while (first < count)
+    {
+        size_t n = std::min<size_t>(count - first, IOV_MAX);
+        for (size_t i = 0; i < n; i++)
+        {
+            ops[first + i].ok = false;
+            local[i] = { ops[first + i].dest, ops[first + i].size };
+            remote[i] = { reinterpret_cast<void *>(ops[first + i].address), ops[first + i].size };
+        }
+
+        ssize_t bytes = process_vm_readv(pid, local.data(), n, remote.data(), n, 0);
+        if (bytes < 0 && errno != EFAULT)
+        {
+            break;
+        }
+
+        // the transfer stops at the first range that faults, everything before it is complete
+        size_t done = 0;
+        size_t total = (bytes > 0) ? static_cast<size_t>(bytes) : 0;
+        while (done < n && total >= ops[first + done].size)
+        {
+            total -= ops[first + done].size;
+            ops[first + done].ok = true;
+            done++;
+        }
+
+        read_ops += done;
+        first += (done < n) ? done + 1 : n;
+    }
+    return read_ops;
+}
+
 size_t ProcUtil::WriteMemoryBytes(pid_t pid, uintptr_t address, void *dest, uint64_t size)
 {
     iovec local_addr { dest, size };
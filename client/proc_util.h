@@ -34,6 +34,18 @@ namespace ProcUtil
     bool ProcessExists(pid_t pid);
 
     size_t ReadMemoryBytes(pid_t pid, uintptr_t address, void *dest, uint64_t size);
+
+    struct ReadOp
+    {
+        uintptr_t address;
+        void *dest;
+        size_t size;
+        bool ok;
+    };
+
+    // Reads every op with as few process_vm_readv calls as possible. A range that faults
+    // only fails itself, reading resumes after it. Returns the number of ops read.
+    size_t ReadMemoryBatch(pid_t pid, ReadOp *ops, size_t count);
     size_t WriteMemoryBytes(pid_t pid, uintptr_t address, void *dest, uint64_t size);
 
     pid_t GetParent(pid_t pid);
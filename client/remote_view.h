@@ -0,0 +1,100 @@
+#ifndef REMOTE_VIEW_H
+#define REMOTE_VIEW_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "proc_util.h"
+
+// A field of a remote object: type and offset from the object address
+template<typename T, size_t Offset>
+struct Field
+{
+    using type = T;
+    static constexpr size_t offset = Offset;
+    static constexpr size_t end = Offset + sizeof(T);
+};
+
+// The span of a remote object that covers all listed fields, read in one go
+template<typename ... Fields>
+struct Layout
+{
+    static constexpr size_t size = std::max({ Fields::end ... });
+};
+
+// Local copy of a remote object, fields are decoded from the copy
+template<typename L>
+class RemoteView
+{
+public:
+    template<typename F>
+    typename F::type get() const
+    {
+        static_assert(F::end <= L::size, "Field is outside of the layout");
+
+        typename F::type value;
+        std::memcpy(&value, &bytes[F::offset], sizeof(value));
+        return value;
+    }
+
+    uintptr_t address = 0;
+    bool ok = false;
+    std::array<uint8_t, L::size> bytes { };
+};
+
+// Reads the views of many objects with one batched read
+template<typename L>
+size_t ReadViews(pid_t pid, RemoteView<L> *views, size_t count)
+{
+    std::vector<ProcUtil::ReadOp> ops(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        ops[i] = { views[i].address, views[i].bytes.data(), L::size, false };
+    }
+
+    size_t read = ProcUtil::ReadMemoryBatch(pid, ops.data(), count);
+    for (size_t i = 0; i < count; i++)
+    {
+        views[i].ok = views[i].address && ops[i].ok;
+    }
+    return read;
+}
+
+// Follows a pointer field of every view and reads the pointed-to objects in one batch
+template<typename F, typename L, typename Target>
+size_t ReadNested(pid_t pid, const RemoteView<L> *views, RemoteView<Target> *targets, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        targets[i].address = views[i].ok ? (views[i].template get<F>() & ~7) : 0;
+    }
+    return ReadViews(pid, targets, count);
+}
+
+namespace layouts
+{
+    // Mirrors game::Ship in do_lib/darkorbit.h
+    struct Ship
+    {
+        using Id            = Field<uint32_t, 0x38>;
+        using LocationInfo  = Field<uintptr_t, 0x40>;
+        using Visible       = Field<uint32_t, 0x74>;
+        using InfoHolder    = Field<uintptr_t, 0xf8>;
+
+        using View = Layout<Id, LocationInfo, Visible, InfoHolder>;
+    };
+
+    struct LocationInfo
+    {
+        using X = Field<double, 0x20>;
+        using Y = Field<double, 0x28>;
+
+        using View = Layout<X, Y>;
+    };
+}
+
+#endif /* REMOTE_VIEW_H */
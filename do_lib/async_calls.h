@@ -0,0 +1,187 @@
+#ifndef ASYNC_CALLS_H
+#define ASYNC_CALLS_H
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "utils.h"
+
+// Calls queued by other threads and run on the flash thread. The slots are preallocated and
+// the callable is copied into inline storage, so queueing a call never touches the heap
+// unless the callable itself owns memory. Such callables are destroyed by the flash thread
+// once they ran, or were dropped after their caller timed out.
+class AsyncCalls
+{
+public:
+    struct Call
+    {
+        enum class State : uint8_t
+        {
+            Free,
+            Pending,
+            Running,
+            Done,
+            Abandoned   // caller timed out, the flash thread releases the slot
+        };
+
+        static constexpr size_t STORAGE_SIZE = 640;
+
+        template<typename F>
+        void set(const F &f)
+        {
+            static_assert(sizeof(F) <= STORAGE_SIZE, "Callable does not fit into AsyncCall storage");
+            static_assert(alignof(F) <= alignof(std::max_align_t), "Callable is overaligned");
+
+            new (storage) F(f);
+            invoke = [] (void *callable) -> uintptr_t
+            {
+                return static_cast<uintptr_t>((*reinterpret_cast<F *>(callable))());
+            };
+
+            destroy = nullptr;
+            if constexpr (!std::is_trivially_destructible_v<F>)
+            {
+                destroy = [] (void *callable)
+                {
+                    reinterpret_cast<F *>(callable)->~F();
+                };
+            }
+        }
+
+        void release()
+        {
+            if (destroy)
+            {
+                destroy(storage);
+                destroy = nullptr;
+            }
+        }
+
+        uintptr_t (*invoke)(void *) = nullptr;
+        void (*destroy)(void *) = nullptr;
+        alignas(std::max_align_t) uint8_t storage[STORAGE_SIZE];
+        uintptr_t result = 0;
+        State state = State::Free;
+    };
+
+    static constexpr size_t MAX_CALLS = 16;
+
+    // Runs f on the flash thread and waits for it. Returns false if no slot was free or the
+    // call did not complete within the timeout.
+    template<typename F>
+    bool call_sync(const F &f, uintptr_t *result = nullptr,
+                   std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        std::unique_lock lk { m_mutex };
+
+        Call *call = nullptr;
+        for (auto &slot : m_calls)
+        {
+            if (slot.state == Call::State::Free)
+            {
+                call = &slot;
+                break;
+            }
+        }
+
+        if (!call)
+        {
+            utils::log("[!] No free async call slot\n");
+            return false;
+        }
+
+        call->set(f);
+        call->state = Call::State::Pending;
+
+        if (!m_cv.wait_for(lk, timeout, [call] { return call->state == Call::State::Done; }))
+        {
+            call->state = Call::State::Abandoned;
+            return false;
+        }
+
+        if (result)
+        {
+            *result = call->result;
+        }
+        call->state = Call::State::Free;
+        return true;
+    }
+
+    // Runs f on the flash thread and moves what it returns into result. The value goes
+    // through a slot shared with the call, so a call that runs after its caller timed out
+    // still frees it.
+    template<typename T, typename F>
+    bool call_sync_value(const F &f, T *result,
+                         std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        auto slot = std::make_shared<T>();
+        if (!call_sync([slot, f] { *slot = f(); return true; }, nullptr, timeout))
+        {
+            return false;
+        }
+
+        *result = std::move(*slot);
+        return true;
+    }
+
+    // Flash thread: runs every pending call
+    void run_pending()
+    {
+        std::array<Call *, MAX_CALLS> batch;
+        size_t count = 0;
+
+        {
+            std::scoped_lock lk { m_mutex };
+            for (auto &call : m_calls)
+            {
+                if (call.state == Call::State::Pending)
+                {
+                    call.state = Call::State::Running;
+                    batch[count++] = &call;
+                }
+                else if (call.state == Call::State::Abandoned)
+                {
+                    // Timed out before we got to it, nobody is waiting for the result anymore
+                    call.release();
+                    call.state = Call::State::Free;
+                }
+            }
+        }
+
+        if (!count)
+        {
+            return;
+        }
+
+        // Run without holding the lock so waiting callers can still time out
+        for (size_t i = 0; i < count; i++)
+        {
+            batch[i]->result = batch[i]->invoke(batch[i]->storage);
+            batch[i]->release();
+        }
+
+        {
+            std::scoped_lock lk { m_mutex };
+            for (size_t i = 0; i < count; i++)
+            {
+                auto &state = batch[i]->state;
+                state = (state == Call::State::Abandoned) ? Call::State::Free : Call::State::Done;
+            }
+        }
+        m_cv.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::array<Call, MAX_CALLS> m_calls;
+};
+
+#endif /* ASYNC_CALLS_H */
@@ -1,37 +1,131 @@
 #include "avm.h"
 #include "binary_stream.h"
+#include "flash_stuff.h"
+#include "page_cache.h"
+#include "pool_index.h"
 #include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
-avm::ClassClosure * avm::AbcEnv::finddef(const std::string &name)
+// Closure cached in a finddef_table entry or nullptr if the script is not initialized yet
+static avm::ClassClosure *finddef_closure(avm::AbcEnv::FinddefTable *table, size_t i)
 {
-    return finddef([name] (avm::ClassClosure *closure)
+    avm::ScriptObject *obj = table->data[i];
+
+    if (!obj)
     {
-        return closure->get_name() == name;
-    });
+        return nullptr;
+    }
+
+    auto *closure = obj->get_at<avm::ClassClosure *>(0x20);
+
+    if (reinterpret_cast<uintptr_t>(closure) <= 0x200000001 || (reinterpret_cast<uintptr_t>(closure) & 7) != 0)
+    {
+        return nullptr;
+    }
+    return closure;
 }
 
-avm::ClassClosure * avm::AbcEnv::finddef(std::function<bool(avm::ClassClosure *)> pred)
+static std::atomic<uint64_t> g_tick { 0 };
+
+// Class name -> finddef_table entry. A miss rescans the table if it grew or at most once per
+// tick, scripts are initialized (and their entries filled in) while the game runs.
+struct FinddefIndex
 {
-    std::vector<avm::ClassClosure *> results;
-    for (size_t i = 0; i < finddef_table->capacity; i++)
+    struct Entry
+    {
+        uint32_t slot;
+        avm::ClassClosure *closure;
+    };
+
+    uint32_t capacity = 0;
+    uint64_t tick = UINT64_MAX;
+    std::unordered_map<std::string, Entry> by_name;
+
+    void build(avm::AbcEnv::FinddefTable *table)
     {
-        avm::ScriptObject *obj = finddef_table->data[i];
+        by_name.clear();
+        capacity = table->capacity;
+        tick = g_tick.load(std::memory_order_relaxed);
 
-        if (!obj)
+        for (uint32_t i = 0; i < table->capacity; i++)
         {
-            continue;
+            if (auto *closure = finddef_closure(table, i))
+            {
+                by_name.emplace(closure->get_name(), Entry { i, closure });
+            }
         }
+    }
 
-        auto *closure = obj->get_at<avm::ClassClosure *>(0x20);
+    avm::ClassClosure *get(avm::AbcEnv::FinddefTable *table, const std::string &name, bool &rebuilt)
+    {
+        auto it = by_name.find(name);
+        if (it != by_name.end() && it->second.slot < table->capacity
+                && finddef_closure(table, it->second.slot) == it->second.closure)
+        {
+            return it->second.closure;
+        }
 
-        if (reinterpret_cast<uintptr_t>(closure) <= 0x200000001 || (reinterpret_cast<uintptr_t>(closure) & 7) != 0)
+        // a stale entry always rebuilds, a plain miss only if there may be something new to index
+        bool stale = it != by_name.end();
+        if (rebuilt || (!stale && table->capacity == capacity && tick == g_tick.load(std::memory_order_relaxed)))
         {
-            continue;
+            return nullptr;
         }
 
-        if (pred(closure))
+        build(table);
+        rebuilt = true;
+
+        it = by_name.find(name);
+        return (it != by_name.end()) ? it->second.closure : nullptr;
+    }
+};
+
+static std::mutex g_finddef_mutex;
+static PageCache<avm::AbcEnv, std::shared_ptr<FinddefIndex>> g_finddef_cache;
+
+static FinddefIndex &finddef_index(avm::AbcEnv *env)
+{
+    if (auto *cached = g_finddef_cache.find(env))
+    {
+        return **cached;
+    }
+    return *g_finddef_cache.insert(env, std::make_shared<FinddefIndex>());
+}
+
+avm::ClassClosure * avm::AbcEnv::finddef(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(g_finddef_mutex);
+    bool rebuilt = false;
+    return finddef_index(this).get(finddef_table, name, rebuilt);
+}
+
+std::vector<avm::ClassClosure *> avm::AbcEnv::finddef(const std::vector<std::string> &names)
+{
+    std::lock_guard<std::mutex> lock(g_finddef_mutex);
+    FinddefIndex &index = finddef_index(this);
+    bool rebuilt = false;
+
+    std::vector<avm::ClassClosure *> closures;
+    closures.reserve(names.size());
+    for (auto &name : names)
+    {
+        closures.push_back(index.get(finddef_table, name, rebuilt));
+    }
+    return closures;
+}
+
+avm::ClassClosure * avm::AbcEnv::finddef(std::function<bool(avm::ClassClosure *)> pred)
+{
+    for (size_t i = 0; i < finddef_table->capacity; i++)
+    {
+        auto *closure = finddef_closure(finddef_table, i);
+
+        if (closure && pred(closure))
         {
             return closure;
         }
@@ -39,17 +133,25 @@ avm::ClassClosure * avm::AbcEnv::finddef(std::function<bool(avm::ClassClosure *)
     return nullptr;
 }
 
-std::string avm::MethodInfo::name()
+static std::mutex g_name_cache_mutex;
+static PageCache<avm::MethodInfo, std::string_view> g_name_cache;
+
+std::string_view avm::MethodInfo::name()
 {
-    static std::mutex cache_mutex;
-    static std::unordered_map<const avm::MethodInfo *, std::string> cache;
+    // lock-free path once the pool's name table is built
+    if (auto *index = PoolIndex::find(pool))
+    {
+        if (auto *entry = index->method_name(id))
+        {
+            return entry->name;
+        }
+    }
 
     // quick-path: check cache under lock, but do expensive work outside
     {
-        std::lock_guard<std::mutex> lock(cache_mutex);
-        auto it = cache.find(this);
-        if (it != cache.end())
-            return it->second;
+        std::lock_guard<std::mutex> lock(g_name_cache_mutex);
+        if (auto *cached = g_name_cache.find(this))
+            return *cached;
     }
 
     // compute resolved name without holding the mutex
@@ -57,152 +159,197 @@ std::string avm::MethodInfo::name()
 
     if (!resolved_name.empty() && declarer.is_traits())
     {
-        auto *traits = declarer.traits();
-        if (traits && traits->traits_pos)
+        if (auto *traits = declarer.traits())
         {
-            BinaryStream s { traits->traits_pos };
-            uint32_t trait_count = 0;
-
-            switch (traits->pos_type)
+            traits->for_each_method_trait([this, &resolved_name] (avm::TraitKind kind, uint32_t method_index)
             {
-                case 0: // instance_info
-                {
-                    /* name */ s.read_u32();
-                    /* super_name */ s.read_u32();
-
-                    auto flags = s.read_u32();
-                    if ((flags & 0x8) != 0)
-                    {
-                        /* protected_ns */ s.read_u32();
-                    }
-
-                    auto interface_count = s.read_u32();
-                    for (uint32_t i = 0; i < interface_count; i++)
-                    {
-                        /* interface */ s.read_u32();
-                    }
-
-                    /* iinit */ s.read_u32();
-                    trait_count = s.read_u32();
-                    break;
-                }
-                case 1: // class_info
-                case 2: // script_info
-                {
-                    /* cinit/init */ s.read_u32();
-                    trait_count = s.read_u32();
-                    break;
-                }
-                default:
+                if (static_cast<int32_t>(method_index) != id)
                 {
-                    break;
+                    return false;
                 }
-            }
 
-            for (uint32_t j = 0; j < trait_count; j++)
-            {
-                /* name */ s.read_u32();
-                unsigned char tag = s.read<uint8_t>();
-                int kind = (tag & avm::TRAIT_mask);
-
-                switch(kind)
+                switch (kind)
                 {
-                    case avm::TRAIT_Slot:
-                    case avm::TRAIT_Const:
-                    {
-                        /* slot_id */ s.read_u32();
-                        /* type_name */ s.read_u32();
-                        uint32_t vindex = s.read_u32();
-                        if (vindex)
-                        {
-                            /* vkind */ s.read<uint8_t>();
-                        }
-                        break;
-                    }
-                    case avm::TRAIT_Class:
-                    case avm::TRAIT_Function:
-                    {
-                        /* slot_id */ s.read_u32();
-                        /* class/function index */ s.read_u32();
+                    case avm::TRAIT_Setter:
+                        resolved_name = "set " + resolved_name;
                         break;
-                    }
-                    case avm::TRAIT_Method:
                     case avm::TRAIT_Getter:
-                    case avm::TRAIT_Setter:
-                    {
-                        /* disp_id */ s.read_u32();
-                        uint32_t method_index = s.read_u32();
-
-                        if (static_cast<int32_t>(method_index) == id)
-                        {
-                            switch (kind)
-                            {
-                                case avm::TRAIT_Setter:
-                                    resolved_name = "set " + resolved_name;
-                                    break;
-                                case avm::TRAIT_Getter:
-                                    resolved_name = "get " + resolved_name;
-                                    break;
-                                default:
-                                    break;
-                            }
-
-                            // insert into cache and return
-                            std::lock_guard<std::mutex> lock(cache_mutex);
-                            cache.try_emplace(this, resolved_name);
-                            return resolved_name;
-                        }
+                        resolved_name = "get " + resolved_name;
                         break;
-                    }
                     default:
-                    {
                         break;
-                    }
                 }
+                return true;
+            });
+        }
+    }
 
-                if (tag & avm::ATTR_metadata)
-                {
-                    uint32_t metadata_count = s.read_u32();
-                    for (uint32_t i = 0; i < metadata_count; i++)
-                    {
-                        /* metadata index */ s.read_u32();
-                    }
-                }
+    // insert final resolved name into cache and return
+    std::string_view interned = intern(resolved_name);
+    {
+        std::lock_guard<std::mutex> lock(g_name_cache_mutex);
+        return g_name_cache.insert(this, interned);
+    }
+}
+
+struct MethodSlots
+{
+    std::unordered_map<std::string_view, std::vector<uint32_t>> by_name;
+};
+
+static std::mutex g_slots_mutex;
+static PageCache<avm::VTable, std::shared_ptr<const MethodSlots>> g_slots_cache;
+
+static std::shared_ptr<const MethodSlots> build_method_slots(avm::VTable *vtable)
+{
+    auto slots = std::make_shared<MethodSlots>();
+    size_t count = vtable->method_count();
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        avm::MethodEnv *env = vtable->methods[i];
+        if (!env || !env->method_info)
+        {
+            continue;
+        }
+
+        std::string_view name = env->method_info->name();
+        if (name.empty())
+        {
+            continue;
+        }
+
+        slots->by_name[name].push_back(i);
+
+        auto separator = name.rfind('/');
+        if (separator != std::string_view::npos)
+        {
+            std::string short_name;
+            if (name.compare(0, 4, "get ") == 0 || name.compare(0, 4, "set ") == 0)
+            {
+                short_name = name.substr(0, 4);
             }
+            short_name += name.substr(separator + 1);
+            slots->by_name[avm::intern(short_name)].push_back(i);
         }
     }
+    return slots;
+}
 
-    // insert final resolved name into cache and return
+size_t avm::VTable::find_methods(std::string_view name, uint32_t *slots, size_t max)
+{
+    std::shared_ptr<const MethodSlots> index;
+    {
+        std::lock_guard<std::mutex> lock(g_slots_mutex);
+        if (auto *cached = g_slots_cache.find(this))
+            index = *cached;
+    }
+
+    if (!index)
     {
-        std::lock_guard<std::mutex> lock(cache_mutex);
-        auto [it, inserted] = cache.try_emplace(this, resolved_name);
-        if (!inserted)
-            return it->second;
-        return it->second;
+        auto built = build_method_slots(this);
+
+        std::lock_guard<std::mutex> lock(g_slots_mutex);
+        index = g_slots_cache.insert(this, std::move(built));
     }
+
+    auto it = index->by_name.find(name);
+    if (it == index->by_name.end())
+    {
+        return 0;
+    }
+
+    size_t count = it->second.size();
+    for (size_t i = 0; i < count && i < max; i++)
+    {
+        slots[i] = it->second[i];
+    }
+    return count;
 }
 
-#include <mutex>
-#include <unordered_map>
+avm::Multiname *avm::PoolObject::find_multiname(std::string_view name)
+{
+    if (auto *index = PoolIndex::find(this))
+    {
+        return index->find_multiname(name);
+    }
+
+    for (uintptr_t i = 0; i < precomp_mn_size; i++)
+    {
+        if (precomp_mn[i+1].name_equals(name))
+        {
+            return &precomp_mn[i+1];
+        }
+    }
+    return nullptr;
+}
+
+std::string_view avm::intern(std::string_view s)
+{
+    static std::mutex intern_mutex;
+    static std::unordered_set<std::string> interned;
+
+    std::lock_guard<std::mutex> lock(intern_mutex);
+    return *interned.emplace(s).first;
+}
+
+static std::mutex g_abc_end_mutex;
+static PageCache<avm::PoolObject, const uint8_t *> g_abc_end_cache;
+
+const uint8_t *avm::PoolObject::abc_end()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_abc_end_mutex);
+        if (auto *cached = g_abc_end_cache.find(this))
+        {
+            return *cached;
+        }
+    }
+
+    // method_info, instance, class and script data precede the method bodies in the abc,
+    // the code of the last body starts after all of them
+    const uint8_t *end = nullptr;
+    for (size_t id = 0, count = method_count(); id < count; id++)
+    {
+        MethodInfo *method = get_method(id);
+        if (method && method->pool == this && method->abc_code > end)
+        {
+            end = method->abc_code;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_abc_end_mutex);
+    return g_abc_end_cache.insert(this, end);
+}
 
 static std::mutex g_traits_cache_mutex;
-static std::unordered_map<const avm::Traits *, avm::MyTraits> g_traits_cache;
+static PageCache<avm::Traits, avm::MyTraitsRef> g_traits_cache;
 
-avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
+avm::MyTraitsRef avm::Traits::parse_traits(avm::PoolObject *custom_pool)
 {
     // fast-path: check global cache
     {
         std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
-        auto it = g_traits_cache.find(this);
-        if (it != g_traits_cache.end())
+        if (auto *cached = g_traits_cache.find(this))
         {
-            return it->second; // copy
+            return *cached;
         }
     }
 
-    BinaryStream s { traits_pos };
     custom_pool = custom_pool ? custom_pool : pool;
-    MyTraits traits;
+    auto traits = std::make_shared<MyTraits>();
+
+    const uint8_t *end = pool ? pool->abc_end() : nullptr;
+    if (!traits_pos || traits_pos >= end)
+    {
+        utils::log("[!] Traits data of {x} is out of bounds\n", reinterpret_cast<uintptr_t>(this));
+        traits->finalize();
+
+        std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
+        return g_traits_cache.insert(this, std::move(traits));
+    }
+
+    BinaryStream s { traits_pos, end };
 
     /* auto qname = */ s.read_u32();
     /* auto qname = */ s.read_u32();
@@ -215,17 +362,21 @@ avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
     }
 
     auto interface_count = s.read_u32();
-    for (uint32_t i = 0; i < interface_count; i++)
+    for (uint32_t i = 0; i < interface_count && s.ok(); i++)
     {
         s.read_u32();
     }
 
     /* auto iinit = */ s.read_u32();
 
+    // a trait takes at least 3 bytes, larger counts can only come from bad data
     uint32_t trait_count = s.read_u32();
-    traits.traits.reserve(trait_count); // avoid repeated reallocations
+    if (s.ok() && trait_count <= static_cast<size_t>(end - traits_pos) / 3)
+    {
+        traits->traits.reserve(trait_count); // avoid repeated reallocations
+    }
 
-    for (uint32_t j = 0; j < trait_count; j++)
+    for (uint32_t j = 0; j < trait_count && s.ok(); j++)
     {
         MyTrait trait;
 
@@ -235,7 +386,7 @@ avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
 
         avm::Multiname *mn = custom_pool->get_multiname(name);
         trait.name_index = name;
-        trait.name = (mn) ? mn->get_name() : "";
+        trait.name = (mn) ? intern(mn->get_name()) : std::string_view();
         trait.kind = kind;
 
         switch(kind)
@@ -243,7 +394,7 @@ avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
             case avm::TRAIT_Slot:
             case avm::TRAIT_Const:
             {
-                /* uint32_t slot_id    = */ s.read_u32();
+                trait.slot_id = s.read_u32();
                 uint32_t type_name  = s.read_u32();
                 uint32_t vindex     = s.read_u32(); // references one of the tables in the constant pool, depending on the value of vkind
                 trait.id = vindex;
@@ -258,14 +409,14 @@ avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
             }
             case avm::TRAIT_Class:
             {
-                /* uint32_t slot_id = */ s.read_u32();
+                trait.slot_id = s.read_u32();
                 uint32_t class_index = s.read_u32(); //  is an index that points into the class array of the abcFile entry
                 trait.id = class_index;
                 break;
             }
             case avm::TRAIT_Function:
             {
-                /* uint32_t slot_id = */ s.read_u32();
+                trait.slot_id = s.read_u32();
                 uint32_t function_index = s.read_u32();
                 trait.id = function_index;
                 break;
@@ -293,27 +444,165 @@ avm::MyTraits avm::Traits::parse_traits(avm::PoolObject *custom_pool)
         if (tag & avm::ATTR_metadata)
         {
             uint32_t metadata_count  = s.read_u32();
-            for (uint32_t i = 0; i < metadata_count; i++)
+            for (uint32_t i = 0; i < metadata_count && s.ok(); i++)
             {
                 /*uint32_t index = */ s.read_u32();
             }
         }
 
-        traits.add_trait(trait);
+        if (!s.ok())
+        {
+            utils::log("[!] Traits data of {x} ends inside a trait\n", reinterpret_cast<uintptr_t>(this));
+            break;
+        }
+        traits->add_trait(trait);
     }
 
+    traits->finalize();
+
     // insert into cache
     {
         std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
-        g_traits_cache.try_emplace(this, traits);
+        return g_traits_cache.insert(this, std::move(traits));
+    }
+}
+
+static std::mutex g_layout_mutex;
+static PageCache<avm::Traits, avm::ClassLayoutRef> g_layout_cache;
+
+avm::ClassLayoutRef avm::Traits::get_layout()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_layout_mutex);
+        if (auto *cached = g_layout_cache.find(this))
+        {
+            return *cached;
+        }
+    }
+
+    auto *bindings = reinterpret_cast<TraitsBindings *>(flash_stuff::gettraitsbinding(this));
+    if (!bindings)
+    {
+        return nullptr;
+    }
+
+    auto layout = std::make_shared<ClassLayout>();
+    layout->name = name();
+    layout->slots.resize(bindings->slot_count);
+
+    SlotInfo *slots = bindings->slots();
+    for (uint32_t i = 0; i < bindings->slot_count; i++)
+    {
+        auto &slot = layout->slots[i];
+        slot.offset = slots[i].offset();
+        slot.sst = slots[i].sst();
+        slot.type = slots[i].type ? slots[i].type->name() : "*";
+    }
+
+    // Every class numbers its own slots after the ones of its base, slot ids are 1 based
+    // and the ones left at 0 get the next free index after the highest declared id
+    for (TraitsBindings *tb = bindings; tb && tb->owner; tb = tb->base)
+    {
+        Traits *owner = tb->owner;
+        if (!owner->traits_pos || owner->pos_type != 0)
+        {
+            continue;
+        }
+
+        uint32_t first = tb->base ? tb->base->slot_count : 0;
+        auto traits = owner->parse_traits();
+
+        uint32_t next = 0;
+        for (const auto &trait : traits->traits)
+        {
+            if (trait.kind != TRAIT_Method && trait.kind != TRAIT_Getter && trait.kind != TRAIT_Setter)
+            {
+                next = std::max(next, static_cast<uint32_t>(trait.slot_id));
+            }
+        }
+
+        for (const auto &trait : traits->traits)
+        {
+            if (trait.kind == TRAIT_Method || trait.kind == TRAIT_Getter || trait.kind == TRAIT_Setter)
+            {
+                continue;
+            }
+
+            uint32_t index = first + (trait.slot_id ? trait.slot_id - 1 : next++);
+            if (index < layout->slots.size())
+            {
+                layout->slots[index].name = trait.name;
+            }
+        }
+    }
+
+    std::stable_sort(layout->slots.begin(), layout->slots.end(), [] (const SlotLayout &a, const SlotLayout &b)
+    {
+        return a.offset < b.offset;
+    });
+
+    std::lock_guard<std::mutex> lock(g_layout_mutex);
+    return g_layout_cache.insert(this, std::move(layout));
+}
+
+void avm::evict_caches(uintptr_t chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
+        g_traits_cache.evict(chunk);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_name_cache_mutex);
+        g_name_cache.evict(chunk);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_finddef_mutex);
+        g_finddef_cache.evict(chunk);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_slots_mutex);
+        g_slots_cache.evict(chunk);
     }
+    {
+        std::lock_guard<std::mutex> lock(g_layout_mutex);
+        g_layout_cache.evict(chunk);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_abc_end_mutex);
+        g_abc_end_cache.evict(chunk);
+    }
+}
 
-    return traits;
+void avm::next_tick()
+{
+    g_tick.fetch_add(1, std::memory_order_relaxed);
 }
 
-void avm::clear_traits_cache()
+void avm::clear_caches()
 {
-    std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
-    g_traits_cache.clear();
+    {
+        std::lock_guard<std::mutex> lock(g_traits_cache_mutex);
+        g_traits_cache.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_name_cache_mutex);
+        g_name_cache.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_finddef_mutex);
+        g_finddef_cache.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_slots_mutex);
+        g_slots_cache.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_layout_mutex);
+        g_layout_cache.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_abc_end_mutex);
+        g_abc_end_cache.clear();
+    }
 }
 
@@ -1,13 +1,18 @@
 #ifndef AVM_H
 #define AVM_H
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <array>
+#include <memory>
 #include <string>
-#include <codecvt> 
-#include <locale>
+#include <string_view>
+#include <unordered_map>
 #include <functional>
+#include <type_traits>
 #include "binary_stream.h"
+#include "utf.h"
+#include "utils.h"
 
 typedef uintptr_t Atom;
 
@@ -26,13 +31,18 @@ namespace avm
 
 #ifdef WIN32
     typedef uintptr_t (__fastcall *MethodInvoke_t)(MethodEnv *, uint32_t, uintptr_t *);
+    typedef double (__fastcall *MethodInvokeDouble_t)(MethodEnv *, uint32_t, uintptr_t *);
 #else
     typedef uintptr_t (*MethodInvoke_t)(MethodEnv *, uint32_t, uintptr_t*);
+    typedef double (*MethodInvokeDouble_t)(MethodEnv *, uint32_t, uintptr_t*);
 #endif
 
     const Atom TRUE = (1 << 3 | 5);
     const Atom FALSE = 5;
 
+    // Upper bound for arguments passed through call_method/construct_instance (matches the ipc argv size)
+    const uint32_t MAX_CALL_ARGS = 64;
+
     enum TraitKind {
         TRAIT_Slot      = 0x00,
         TRAIT_Method    = 0x01,
@@ -51,6 +61,9 @@ namespace avm
 
 
 
+    /* Returns a view of s that stays valid for the lifetime of the process */
+    std::string_view intern(std::string_view s);
+
     class MyTrait
     {
     public:
@@ -59,49 +72,64 @@ namespace avm
         avm::TraitKind kind;
         int type_id = 0;
         int id = 0;
+        int slot_id = 0; // slots, consts, classes and functions; 0 = assigned by the avm
         int temp;
 
         int name_index = 0;
 
-        std::string name;
+        std::string_view name; // interned
     };
 
 
+    // Parsed traits are immutable once cached and shared between callers
     struct MyTraits
     {
-        inline void add_trait(MyTrait &t)
+        MyTraits() = default;
+        MyTraits(const MyTraits &) = delete;
+        MyTraits &operator=(const MyTraits &) = delete;
+
+        inline void add_trait(const MyTrait &t)
         {
             traits.push_back(t);
         }
 
-        bool has_trait(const std::string &name)
+        // Build the name index and slot list once all traits are added
+        void finalize()
         {
-            for (auto &trait : traits)
+            by_name.reserve(traits.size());
+            for (uint32_t i = 0; i < traits.size(); i++)
             {
-                if (trait.name == name)
+                by_name.emplace(traits[i].name, i);
+                if (traits[i].kind == avm::TRAIT_Slot)
                 {
-                    return true;
+                    slots.push_back(&traits[i]);
                 }
             }
-            return false;
         }
 
-        std::vector<MyTrait> get_slots()
+        inline const MyTrait *find(std::string_view name) const
         {
-            std::vector<MyTrait> r;
-            for (auto &trait : traits)
-            {
-                if (trait.kind == avm::TRAIT_Slot)
-                {
-                    r.push_back(trait);
-                }
-            }
-            return r;
+            auto it = by_name.find(name);
+            return (it != by_name.end()) ? &traits[it->second] : nullptr;
+        }
+
+        inline bool has_trait(std::string_view name) const
+        {
+            return find(name) != nullptr;
+        }
+
+        inline const std::vector<const MyTrait *> &get_slots() const
+        {
+            return slots;
         }
 
         std::vector<MyTrait> traits;
+        std::unordered_map<std::string_view, uint32_t> by_name; // first trait with that name
+        std::vector<const MyTrait *> slots;
     };
 
+    typedef std::shared_ptr<const MyTraits> MyTraitsRef;
+
 
 
     struct GC
@@ -201,22 +229,55 @@ namespace avm
         /// Is this an interned string?
         inline bool        isInterned() const { return (flags & TSTR_INTERNED_FLAG) != 0; }
 
-        std::string read(uintptr_t offset = 0)
+        // Characters of the string, a dependent string points into its master's buffer
+        inline const void *chars() const
         {
             if (isDependent())
-                return extra->read(offset);
+                return extra->data + offset;
+            return data;
+        }
 
-            //p8 = self->m_extra.master->m_buffer.p8 + self->m_buffer.offset_bytes;
+        // utf-8, 8 bit strings are latin-1
+        std::string read() const
+        {
+            if (getWidth() == Width::k16)
+                return utf::from_utf16(static_cast<const char16_t *>(chars()), size);
+            return utf::from_latin1(static_cast<const uint8_t *>(chars()), size);
+        }
 
+        // Same as read() == s without converting the string
+        bool equals(std::string_view s) const
+        {
             if (getWidth() == Width::k16)
+                return utf::equals(static_cast<const char16_t *>(chars()), size, s);
+            return utf::equals(static_cast<const uint8_t *>(chars()), size, s);
+        }
+
+        // utils::fnv1a of the utf-8 form returned by read(), without building it
+        uint64_t hash() const
+        {
+            utils::Fnv1a h;
+            auto add = [&h] (uint32_t cp)
             {
-                std::wstring_convert<std::codecvt_utf8_utf16<char16_t>,char16_t> convert;
-                return convert.to_bytes(
-                        reinterpret_cast<char16_t *>(&data[offset]),
-                        reinterpret_cast<char16_t *>(&data[size * 2]));
-            }
+                uint8_t buf[4];
+                h.add(buf, utf::encode(cp, buf));
+            };
 
-            return std::string(&data[offset], &data[size]);
+            if (getWidth() == Width::k16)
+            {
+                utf::for_each_code_point(static_cast<const char16_t *>(chars()), size, add);
+            }
+            else
+            {
+                auto *p = static_cast<const uint8_t *>(chars());
+                size_t ascii = utf::ascii_prefix(p, size);
+                h.add(p, ascii);
+                for (size_t i = ascii; i < size; i++)
+                {
+                    add(p[i]);
+                }
+            }
+            return h.value;
         }
 
         wchar_t operator[](size_t index)
@@ -267,6 +328,14 @@ namespace avm
                 return name->read();
             return "";
         }
+
+        // Same as get_name() == s without converting the name
+        bool name_equals(std::string_view s)
+        {
+            if (!(flags & 8) && name) // RTNAME
+                return name->equals(s);
+            return s.empty();
+        }
     };
 
     struct Builtins
@@ -324,23 +393,29 @@ namespace avm
             return method_list[id + 2];
         }
 
-        Multiname *get_multiname(uint32_t id)
+        // method_list is a gc list, its capacity follows from the allocation size
+        size_t method_count()
         {
-            return (id < precomp_mn_size) ? &precomp_mn[id + 1] : nullptr;
+            if (!method_list)
+            {
+                return 0;
+            }
+            size_t alloc_size = get_block_header(method_list)->size;
+            return (alloc_size > 2 * sizeof(uintptr_t)) ? (alloc_size / sizeof(uintptr_t)) - 2 : 0;
         }
 
-        Multiname *find_multiname(const std::string &name)
+        Multiname *get_multiname(uint32_t id)
         {
-            for (uintptr_t i = 0; i < precomp_mn_size; i++)
-            {
-                if (precomp_mn[i+1].get_name() == name)
-                {
-                    return &precomp_mn[i+1];
-                }
-            }
-            return nullptr;
+            return (id < precomp_mn_size) ? &precomp_mn[id + 1] : nullptr;
         }
 
+        // Hashed lookup through the PoolIndex, linear scan if the pool has no index
+        Multiname *find_multiname(std::string_view name);
+
+        // Bound for reads of method_info, instance, class and script data, nullptr if the pool
+        // has no method bodies. Computed once per pool.
+        const uint8_t *abc_end();
+
         std::string get_method_name(uint32_t method_index)
         {
             int32_t name_index = method_name_indices[1 + method_index];
@@ -459,19 +534,37 @@ namespace avm
         {
             std::vector<uint32_t> result;
 
-            BinaryStream str(abc_info);
+            const uint8_t *end = pool ? pool->abc_end() : nullptr;
+            if (!abc_info || abc_info >= end)
+            {
+                return result;
+            }
+
+            BinaryStream str(abc_info, end);
             uint32_t param_count = str.read_u32();
             /*uint32_t ret_type =*/ str.read_u32();
+
+            // every type is at least one byte
+            if (!str.ok() || param_count > static_cast<size_t>(end - abc_info))
+            {
+                return result;
+            }
             result.reserve(param_count);
 
             for (uint32_t i = 0; i < param_count; i++)
             {
                 result.push_back(str.read_u32());
             }
+
+            if (!str.ok())
+            {
+                result.clear();
+            }
             return result;
         }
 
-        std::string name();
+        // Interned, "get "/"set " prefixed for accessors
+        std::string_view name();
 
         inline bool compiled() {
             return ((flags >> 21) & 1) == 1;
@@ -494,7 +587,10 @@ namespace avm
 
         };
 
+        // Indexed by class name, a miss rescans the table if it grew or once per tick
         avm::ClassClosure * finddef(const std::string &name);
+        // Resolves many names with at most one index rebuild, nullptr for names not found
+        std::vector<avm::ClassClosure *> finddef(const std::vector<std::string> &names);
         avm::ClassClosure * finddef(std::function<bool(avm::ClassClosure *)> pred);
 
         uintptr_t cpp_vtable;
@@ -526,6 +622,12 @@ namespace avm
         {
             return method_proc(this, argc, argv);
         }
+
+        // Methods returning Number leave the result in a floating point register
+        double invoke_double(int argc, uintptr_t *argv)
+        {
+            return reinterpret_cast<MethodInvokeDouble_t>(method_proc)(this, argc, argv);
+        }
     };
 
     enum SlotStorageType
@@ -579,6 +681,24 @@ namespace avm
         }
     };
 
+    // Where a named slot lives inside an instance
+    struct SlotLayout
+    {
+        std::string_view name; // interned, empty if the declaring class has no abc traits
+        std::string type;      // declared type, "*" if untyped
+        uint32_t offset;
+        SlotStorageType sst;
+    };
+
+    // All slots of a class including the inherited ones, ordered by offset
+    struct ClassLayout
+    {
+        std::string name;
+        std::vector<SlotLayout> slots;
+    };
+
+    typedef std::shared_ptr<const ClassLayout> ClassLayoutRef;
+
     struct Traits
     {
         void *cpp_vtable;
@@ -613,11 +733,127 @@ namespace avm
             return (_name) ? _name->read() : "";
         }
 
-        MyTraits parse_traits(avm::PoolObject *custom_pool = nullptr);
+        MyTraitsRef parse_traits(avm::PoolObject *custom_pool = nullptr);
+
+        // Slot layout from the traits bindings, cached per traits. Runs on the flash thread.
+        ClassLayoutRef get_layout();
+
+        // Walks the method/getter/setter traits in the abc data of this traits,
+        // f(kind, method_index) returns true to stop
+        template<typename F>
+        void for_each_method_trait(F &&f) const
+        {
+            const uint8_t *end = pool ? pool->abc_end() : nullptr;
+            if (!traits_pos || traits_pos >= end)
+            {
+                return;
+            }
+
+            BinaryStream s { traits_pos, end };
+            uint32_t trait_count = 0;
+
+            switch (pos_type)
+            {
+                case 0: // instance_info
+                {
+                    /* name */ s.read_u32();
+                    /* super_name */ s.read_u32();
+
+                    auto flags = s.read_u32();
+                    if ((flags & 0x8) != 0)
+                    {
+                        /* protected_ns */ s.read_u32();
+                    }
+
+                    auto interface_count = s.read_u32();
+                    for (uint32_t i = 0; i < interface_count && s.ok(); i++)
+                    {
+                        /* interface */ s.read_u32();
+                    }
+
+                    /* iinit */ s.read_u32();
+                    trait_count = s.read_u32();
+                    break;
+                }
+                case 1: // class_info
+                case 2: // script_info
+                {
+                    /* cinit/init */ s.read_u32();
+                    trait_count = s.read_u32();
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+
+            for (uint32_t j = 0; j < trait_count && s.ok(); j++)
+            {
+                /* name */ s.read_u32();
+                unsigned char tag = s.read<uint8_t>();
+                int kind = (tag & avm::TRAIT_mask);
+
+                switch(kind)
+                {
+                    case avm::TRAIT_Slot:
+                    case avm::TRAIT_Const:
+                    {
+                        /* slot_id */ s.read_u32();
+                        /* type_name */ s.read_u32();
+                        uint32_t vindex = s.read_u32();
+                        if (vindex)
+                        {
+                            /* vkind */ s.read<uint8_t>();
+                        }
+                        break;
+                    }
+                    case avm::TRAIT_Class:
+                    case avm::TRAIT_Function:
+                    {
+                        /* slot_id */ s.read_u32();
+                        /* class/function index */ s.read_u32();
+                        break;
+                    }
+                    case avm::TRAIT_Method:
+                    case avm::TRAIT_Getter:
+                    case avm::TRAIT_Setter:
+                    {
+                        /* disp_id */ s.read_u32();
+                        uint32_t method_index = s.read_u32();
+
+                        if (s.ok() && f(avm::TraitKind(kind), method_index))
+                        {
+                            return;
+                        }
+                        break;
+                    }
+                    default:
+                    {
+                        break;
+                    }
+                }
+
+                if (tag & avm::ATTR_metadata)
+                {
+                    uint32_t metadata_count = s.read_u32();
+                    for (uint32_t i = 0; i < metadata_count && s.ok(); i++)
+                    {
+                        /* metadata index */ s.read_u32();
+                    }
+                }
+            }
+        }
     };
 
-    /* Clear cached parsed traits (used to invalidate cached entries when VM memory is freed) */
-    void clear_traits_cache();
+    /* Drop cached traits/method names whose key lives in a chunk the GC just freed */
+    void evict_caches(uintptr_t chunk);
+
+    /* Drop every cached traits/method name */
+    void clear_caches();
+
+    /* End of a game tick, a finddef miss rescans its table at most once per tick */
+    void next_tick();
 
     struct VTable
     {
@@ -631,6 +867,22 @@ namespace avm
         uint8_t pad0[0x78 - 0x38];
         MethodEnv *methods[1];
 
+        // Number of method slots, follows from the allocation size of the vtable
+        size_t method_count()
+        {
+            return (get_block_header(this)->size - 0x78) / 8;
+        }
+
+        MethodEnv *get_method(size_t slot)
+        {
+            return (slot < method_count()) ? methods[slot] : nullptr;
+        }
+
+        // Slots of the methods called `name`, matched against MethodInfo::name() as is and
+        // without its namespace ("get ns/foo" -> "get foo"). The index is cached per vtable.
+        // Writes up to max slots in ascending order and returns how many matched in total.
+        size_t find_methods(std::string_view name, uint32_t *slots, size_t max);
+
         std::vector<MethodEnv *> get_methods()
         {
             std::vector<MethodEnv *> result;
@@ -680,17 +932,24 @@ namespace avm
             return vtable->traits->name();
         }
 
-        uintptr_t call_method(uint32_t index, uint32_t argc, void *argv)
+        // R = double for methods returning Number
+        template<typename R = uintptr_t>
+        R call_method(uint32_t index, uint32_t argc, const uintptr_t *argv)
         {
-            std::vector<uintptr_t> args { reinterpret_cast<uintptr_t>(this)};
+            avm::MethodEnv *env = vtable->methods[index];
+            if (!env || argc > MAX_CALL_ARGS)
+                return 0;
+
+            uintptr_t args[MAX_CALL_ARGS + 1];
+            args[0] = reinterpret_cast<uintptr_t>(this);
 
             if (argc)
-                args.insert(args.end(), reinterpret_cast<uintptr_t *>(argv), &reinterpret_cast<uintptr_t *>(argv)[argc]);
+                std::memcpy(&args[1], argv, argc * sizeof(uintptr_t));
 
-            avm::MethodEnv *env = vtable->methods[index];
-            if (!env)
-                return 0;
-            return env->invoke(argc, args.data());
+            if constexpr (std::is_same_v<R, double>)
+                return env->invoke_double(argc, args);
+            else
+                return env->invoke(argc, args);
         }
 
         uintptr_t call(uint32_t index)
@@ -738,18 +997,23 @@ namespace avm
         ScriptObject *prototype;
         CreateInstanceProc create_instance_proc;
 
-        ScriptObject *construct_instance(Atom *argv, uint32_t argc)
+        ScriptObject *construct_instance(const Atom *argv, uint32_t argc)
         {
-            std::vector<Atom> real_argv { reinterpret_cast<uintptr_t>(this) };
+            if (argc > MAX_CALL_ARGS)
+            {
+                return nullptr;
+            }
+
+            Atom real_argv[MAX_CALL_ARGS + 1];
 
             if (argc)
             {
-                real_argv.insert(real_argv.end(), argv, &argv[argc]);
+                std::memcpy(&real_argv[1], argv, argc * sizeof(Atom));
             }
 
             ScriptObject *inst = this->vtable->ivtable->create_instance_proc(this);
             real_argv[0] = reinterpret_cast<Atom>(inst);
-            this->vtable->ivtable->einit->invoke(argc, real_argv.data());
+            this->vtable->ivtable->einit->invoke(argc, real_argv);
             return inst;
         }
 
@@ -789,6 +1053,45 @@ namespace avm
     {
         return T(reinterpret_cast<uintptr_t>(val) & ~7);
     }
+
+    // Where an Array / Vector.<*> keeps its element buffer and length, elements start
+    // at buffer + 0x10. The client reads collections with the same offsets.
+    struct CollectionLayout
+    {
+        uint32_t buffer_offset;
+        uint32_t size_offset;
+    };
+
+    constexpr CollectionLayout ARRAY_LAYOUT     { 0x20, 0x28 };
+    constexpr CollectionLayout VECTOR_LAYOUT    { 0x30, 0x38 };
+    constexpr uint32_t COLLECTION_ELEMENTS      = 0x10;
+
+    // Calls f(element) with the atom tag removed for every element of the collection
+    template<typename F>
+    inline static void for_each_element(const void *collection, const CollectionLayout &layout, F &&f)
+    {
+        if (!collection)
+        {
+            return;
+        }
+
+        auto *base = static_cast<const uint8_t *>(collection);
+        uintptr_t buffer;
+        uint32_t size;
+        std::memcpy(&buffer, base + layout.buffer_offset, sizeof(buffer));
+        std::memcpy(&size, base + layout.size_offset, sizeof(size));
+
+        if (!buffer)
+        {
+            return;
+        }
+
+        auto *elements = reinterpret_cast<const uintptr_t *>(buffer + COLLECTION_ELEMENTS);
+        for (uint32_t i = 0; i < size; i++)
+        {
+            f(remove_kind(elements[i]));
+        }
+    }
 };
 
 
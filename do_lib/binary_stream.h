@@ -2,20 +2,29 @@
 #define BINARY_STREAM_H
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <cstring>
 
 
+// Reader over abc data. Without an end pointer reads are unchecked; with one, a read
+// that would cross it returns 0, leaves the position at the end and clears ok().
 class BinaryStream
 {
     public:
     BinaryStream(const uint8_t *data_ptr) : data(data_ptr) { }
+    BinaryStream(const uint8_t *data_ptr, const uint8_t *end_ptr) : data(data_ptr), end(end_ptr) { }
 
     std::string read_string()
     {
         // find the null terminator and construct the string in one allocation
         size_t start = position;
-        while (data[position] != 0x00)
+        while ((!end || &data[position] < end) && data[position] != 0x00)
             ++position;
+        if (end && &data[position] >= end)
+        {
+            fail();
+            return std::string();
+        }
         size_t len = position - start;
         std::string out_str(reinterpret_cast<const char *>(&data[start]), len);
         // advance past the terminator
@@ -25,6 +34,11 @@ class BinaryStream
 
     void read_bytes(unsigned char *out, size_t size)
     {
+        if (!has(size))
+        {
+            fail();
+            return;
+        }
         memcpy(out, &data[position], size);
         position += size;
     }
@@ -32,7 +46,12 @@ class BinaryStream
     template<typename T>
     inline T read()
     {
-        T r;
+        T r { };
+        if (!has(sizeof(T)))
+        {
+            fail();
+            return r;
+        }
         std::memcpy(&r, &data[position], sizeof(T));
         position += sizeof(T);
         return r;
@@ -41,19 +60,57 @@ class BinaryStream
     template<typename T>
     inline T peek()
     {
-        T r;
-        std::memcpy(&r, &data[position], sizeof(T));
+        T r { };
+        if (has(sizeof(T)))
+        {
+            std::memcpy(&r, &data[position], sizeof(T));
+        }
         return r;
     }
 
     int32_t read_s24()
     {
+        if (!has(3))
+        {
+            fail();
+            return 0;
+        }
         auto b = (data[position] | data[position+1]<<8 | ((int8_t)data[position+2])<<16 );
         position += 3;
         return b;
     }
 
     uint32_t read_u32()
+    {
+        const uint8_t *p = &data[position];
+
+        // whole word when the 8 byte load stays in bounds (or on the current page if unbounded)
+        if (end ? (end - p >= 8) : ((reinterpret_cast<uintptr_t>(p) & 0xfff) <= 0xff8))
+        {
+            uint64_t w;
+            std::memcpy(&w, p, sizeof(w));
+
+            // first byte without the continuation bit ends the varint, the 5th byte always does
+            uint64_t stops = ~w & 0x80808080ULL;
+            uint32_t size = stops ? (__builtin_ctzll(stops) >> 3) + 1 : 5;
+
+            uint64_t value = (w & 0x7f)
+                           | ((w >> 1) & (0x7fULL << 7))
+                           | ((w >> 2) & (0x7fULL << 14))
+                           | ((w >> 3) & (0x7fULL << 21))
+                           | ((w >> 4) & (0xffULL << 28));
+
+            position += size;
+            return static_cast<uint32_t>(size < 5 ? value & ((1ULL << (7 * size)) - 1) : value);
+        }
+
+        return read_u32_slow();
+    }
+
+    inline uint32_t read_u30() { return read_u32(); }
+
+    // Byte at a time decoder, used near the end of the data
+    uint32_t read_u32_slow()
     {
         unsigned int result = read<uint8_t>();
         if ((result & 0x00000080) == 0)
@@ -78,11 +135,31 @@ class BinaryStream
         return (result & 0x0FFFFFFF) | read<uint8_t>() << 28;
     }
 
-    inline uint32_t read_u30() { return read_u32(); }
+    inline bool ok() const
+    {
+        return m_ok;
+    }
 
+    inline bool has(size_t size) const
+    {
+        return !end || (&data[position] <= end && static_cast<size_t>(end - &data[position]) >= size);
+    }
 
     size_t position = 0;
     const uint8_t *data;
+    const uint8_t *end = nullptr;
+
+    private:
+    inline void fail()
+    {
+        m_ok = false;
+        if (end)
+        {
+            position = end - data;
+        }
+    }
+
+    bool m_ok = true;
 };
 
 
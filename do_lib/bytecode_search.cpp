@@ -0,0 +1,258 @@
+#include "bytecode_search.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+#include "pool_index.h"
+#include "utils.h"
+
+static bool parse_opcode(const std::string &mnemonic, ABC::OpCode *opcode)
+{
+    for (size_t i = 0; i < ABC::Opcodes.size(); i++)
+    {
+        if (ABC::Opcodes[i].name && mnemonic == ABC::Opcodes[i].name)
+        {
+            *opcode = static_cast<ABC::OpCode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+BytecodePattern::BytecodePattern(const std::string &text) : m_text(text)
+{
+    std::string line;
+    std::stringstream lines(text);
+
+    // leading and trailing gaps make the pattern match anywhere in the body
+    m_elements.push_back(Element { Element::Gap });
+
+    while (std::getline(lines, line, ';'))
+    {
+        std::replace(line.begin(), line.end(), '\n', ' ');
+
+        std::stringstream tokens(line);
+        std::string token;
+        if (!(tokens >> token))
+        {
+            continue;
+        }
+
+        Element element;
+        if (token == "*")
+        {
+            element.kind = Element::Gap;
+        }
+        else if (token == "??")
+        {
+            element.kind = Element::AnyInstruction;
+        }
+        else if (!parse_opcode(token, &element.opcode))
+        {
+            utils::log("[!] Unknown opcode {} in pattern\n", token);
+            return;
+        }
+
+        while (tokens >> token)
+        {
+            if (element.kind != Element::Instruction || element.operand_count == ABC::OpInfo::MAX_OPERANDS)
+            {
+                utils::log("[!] Unexpected operand {} in pattern\n", token);
+                return;
+            }
+
+            if (token == "?")
+            {
+                element.wildcards |= 1 << element.operand_count;
+            }
+            else
+            {
+                char *end = nullptr;
+                // same hex format as AbcInstruction::ToString, negative values print as ffffxxxx
+                element.operands[element.operand_count] = static_cast<int32_t>(strtoul(token.c_str(), &end, 16));
+                if (!end || *end)
+                {
+                    utils::log("[!] Invalid operand {} in pattern\n", token);
+                    return;
+                }
+            }
+            element.operand_count++;
+        }
+
+        if (element.kind != Element::Gap || m_elements.back().kind != Element::Gap)
+        {
+            m_elements.push_back(element);
+        }
+    }
+
+    if (m_elements.size() == 1)
+    {
+        return;
+    }
+
+    if (m_elements.back().kind != Element::Gap)
+    {
+        m_elements.push_back(Element { Element::Gap });
+    }
+    m_valid = true;
+}
+
+bool BytecodePattern::Matches(const Element &element, const AbcInstruction &inst) const
+{
+    if (element.kind == Element::AnyInstruction)
+    {
+        return true;
+    }
+
+    if (element.opcode != inst.opcode)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < element.operand_count; i++)
+    {
+        if ((element.wildcards & (1 << i)) == 0 && (i >= inst.operand_count || inst.operands[i] != element.operands[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BytecodePattern::Match(const AbcInstruction *code, size_t count) const
+{
+    if (!m_valid)
+    {
+        return false;
+    }
+
+    // glob matching, a gap is retried one instruction further on a mismatch
+    size_t p = 0, s = 0;
+    size_t gap = SIZE_MAX, gap_start = 0;
+
+    while (s < count)
+    {
+        if (p < m_elements.size() && m_elements[p].kind == Element::Gap)
+        {
+            gap = p++;
+            gap_start = s;
+        }
+        else if (p < m_elements.size() && Matches(m_elements[p], code[s]))
+        {
+            p++;
+            s++;
+        }
+        else if (gap != SIZE_MAX)
+        {
+            p = gap + 1;
+            s = ++gap_start;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (p < m_elements.size() && m_elements[p].kind == Element::Gap)
+    {
+        p++;
+    }
+    return p == m_elements.size();
+}
+
+bool BytecodePattern::Match(const uint8_t *body) const
+{
+    // reused per thread, matching a body does not allocate once it has grown
+    thread_local std::vector<AbcInstruction> code;
+    code.clear();
+
+    if (!m_valid || !Disassembler::Visit(body, [] (const AbcInstruction &inst)
+        {
+            code.push_back(inst);
+            return false;
+        }))
+    {
+        return false;
+    }
+    return Match(code.data(), code.size());
+}
+
+struct Search
+{
+    size_t cursor = 0;
+    std::vector<int32_t> ids;
+    bool done = false;
+};
+
+// (abc hash, pool if there is no hash, pattern)
+static std::map<std::tuple<uint64_t, uintptr_t, std::string>, Search> g_searches;
+
+uint64_t BytecodeSearch::AbcHash(avm::PoolObject *pool)
+{
+    if (auto *index = PoolIndex::find(pool))
+    {
+        return index->abc_hash();
+    }
+    return PoolIndex::hash_abc(pool);
+}
+
+bool BytecodeSearch::FindMethods(avm::PoolObject *pool, const BytecodePattern &pattern, size_t &budget,
+                                 std::vector<int32_t> *ids)
+{
+    ids->clear();
+    if (!pool || !pattern.valid())
+    {
+        return true;
+    }
+
+    uint64_t hash = AbcHash(pool);
+    auto &search = g_searches[{ hash, hash ? 0 : reinterpret_cast<uintptr_t>(pool), pattern.text() }];
+
+    size_t count = pool->method_count();
+    for (; !search.done && search.cursor < count && budget; search.cursor++)
+    {
+        size_t id = search.cursor;
+        avm::MethodInfo *method = pool->get_method(id);
+        if (!method || method->pool != pool || static_cast<size_t>(method->id) != id || !method->abc_code)
+        {
+            continue;
+        }
+
+        budget--;
+        if (pattern.Match(method->abc_code))
+        {
+            search.ids.push_back(static_cast<int32_t>(id));
+        }
+    }
+
+    if (!search.done && search.cursor < count)
+    {
+        return false;
+    }
+
+    if (!search.done)
+    {
+        search.done = true;
+        utils::log("[+] Pattern matched {} of {} methods\n", search.ids.size(), count);
+    }
+
+    *ids = search.ids;
+    return true;
+}
+
+void BytecodeSearch::Evict(uintptr_t chunk)
+{
+    for (auto it = g_searches.begin(); it != g_searches.end(); )
+    {
+        uintptr_t pool = std::get<1>(it->first);
+        it = (pool && (pool & ~0xfffULL) == chunk) ? g_searches.erase(it) : std::next(it);
+    }
+}
+
+void BytecodeSearch::ClearCache()
+{
+    g_searches.clear();
+}
@@ -0,0 +1,79 @@
+#ifndef BYTECODE_SEARCH_H
+#define BYTECODE_SEARCH_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "avm.h"
+#include "disassembler.h"
+
+// Instruction pattern written like Disassembly output, one instruction per ';' or line:
+//
+//     getlex ? ; * ; callproperty 85 0 ; ?? ; returnvoid
+//
+// Operands are hex, `?` matches any value and missing trailing operands match anything.
+// `??` matches exactly one instruction and `*` any run of instructions (also none).
+// A pattern matches if it occurs anywhere in the method body.
+class BytecodePattern
+{
+public:
+    struct Element
+    {
+        enum Kind : uint8_t
+        {
+            Instruction,
+            AnyInstruction,
+            Gap
+        };
+
+        Kind kind = Instruction;
+        ABC::OpCode opcode = ABC::OP_nop;
+        uint8_t operand_count = 0;              // operands given in the pattern
+        uint8_t wildcards = 0;                  // bit i set: operand i is `?`
+        int32_t operands[ABC::OpInfo::MAX_OPERANDS] = { };
+    };
+
+    BytecodePattern() = default;
+    explicit BytecodePattern(const std::string &text);
+
+    inline bool valid() const
+    {
+        return m_valid;
+    }
+
+    inline const std::string &text() const
+    {
+        return m_text;
+    }
+
+    bool Match(const uint8_t *body) const;
+    bool Match(const AbcInstruction *code, size_t count) const;
+
+private:
+    bool Matches(const Element &element, const AbcInstruction &inst) const;
+
+    std::string m_text;
+    std::vector<Element> m_elements;
+    bool m_valid = false;
+};
+
+// Flash thread only, the pool's method bodies are GC memory
+class BytecodeSearch
+{
+public:
+    // Fingerprint of the abc a pool was loaded from, equal across reloads of the same swf
+    static uint64_t AbcHash(avm::PoolObject *pool);
+
+    // Ids of the pool's methods whose body matches, ascending. Decodes at most budget bodies
+    // and takes them off budget, returns false while the search is incomplete: the next call
+    // with the same pool and pattern continues it. Searches are kept by abc hash and pattern,
+    // by pool and pattern if the pool has no hash, until Evict() / ClearCache().
+    static bool FindMethods(avm::PoolObject *pool, const BytecodePattern &pattern, size_t &budget,
+                            std::vector<int32_t> *ids);
+
+    // Forget the searches of pools inside a freed chunk
+    static void Evict(uintptr_t chunk);
+    static void ClearCache();
+};
+
+#endif /* BYTECODE_SEARCH_H */
@@ -0,0 +1,140 @@
+#ifndef CALL_CACHE_H
+#define CALL_CACHE_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "utils.h"
+
+// Results of calls the client marked as pure, valid until the end of the current tick.
+// Open addressing with linear probing; entries carry the generation they were stored in,
+// so starting a new tick invalidates all of them without touching the table.
+class CallCache
+{
+public:
+    static constexpr size_t CAPACITY = 1024;    // power of two
+    static constexpr size_t MAX_PROBES = 8;
+    static constexpr uint32_t MAX_ARGS = 4;     // calls with more arguments are not cached
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t uncached;  // too many arguments
+    };
+
+    bool find(uintptr_t object, uint32_t index, uint32_t argc, const uintptr_t *argv, uintptr_t &value)
+    {
+        std::scoped_lock lk { m_mutex };
+        if (argc > MAX_ARGS)
+        {
+            m_stats.uncached++;
+            return false;
+        }
+
+        size_t home = hash(object, index, argc, argv);
+        for (size_t i = 0; i < MAX_PROBES; i++)
+        {
+            const Entry &entry = m_entries[(home + i) & (CAPACITY - 1)];
+            if (entry.generation != m_generation)
+            {
+                break;
+            }
+            if (entry.matches(object, index, argc, argv))
+            {
+                value = entry.value;
+                m_stats.hits++;
+                return true;
+            }
+        }
+
+        m_stats.misses++;
+        return false;
+    }
+
+    void insert(uintptr_t object, uint32_t index, uint32_t argc, const uintptr_t *argv, uintptr_t value)
+    {
+        std::scoped_lock lk { m_mutex };
+        if (argc > MAX_ARGS)
+        {
+            return;
+        }
+
+        // first stale slot, or the home slot if the whole probe run is live
+        size_t home = hash(object, index, argc, argv);
+        Entry *slot = &m_entries[home];
+        for (size_t i = 0; i < MAX_PROBES; i++)
+        {
+            Entry &entry = m_entries[(home + i) & (CAPACITY - 1)];
+            if (entry.generation != m_generation || entry.matches(object, index, argc, argv))
+            {
+                slot = &entry;
+                break;
+            }
+        }
+
+        slot->generation = m_generation;
+        slot->index = index;
+        slot->argc = argc;
+        slot->object = object;
+        std::memcpy(slot->args, argv, argc * sizeof(uintptr_t));
+        slot->value = value;
+    }
+
+    // Called at the end of every tick
+    void next_generation()
+    {
+        std::scoped_lock lk { m_mutex };
+        if (++m_generation == 0)
+        {
+            // wrapped, entries from 2^32 ticks ago would look valid again
+            m_entries = { };
+            m_generation = 1;
+        }
+    }
+
+    Stats stats(bool reset)
+    {
+        std::scoped_lock lk { m_mutex };
+        Stats stats = m_stats;
+        if (reset)
+        {
+            m_stats = { };
+        }
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t generation;
+        uint32_t index;
+        uint32_t argc;
+        uintptr_t object;
+        uintptr_t args[MAX_ARGS];
+        uintptr_t value;
+
+        inline bool matches(uintptr_t o, uint32_t i, uint32_t n, const uintptr_t *argv) const
+        {
+            return object == o && index == i && argc == n && std::memcmp(args, argv, n * sizeof(uintptr_t)) == 0;
+        }
+    };
+
+    static size_t hash(uintptr_t object, uint32_t index, uint32_t argc, const uintptr_t *argv)
+    {
+        utils::Fnv1a h;
+        h.add(&object, sizeof(object));
+        h.add(&index, sizeof(index));
+        h.add(argv, argc * sizeof(uintptr_t));
+        return h.value & (CAPACITY - 1);
+    }
+
+    std::mutex m_mutex;
+    std::array<Entry, CAPACITY> m_entries { };
+    uint32_t m_generation = 1;
+    Stats m_stats { };
+};
+
+#endif /* CALL_CACHE_H */
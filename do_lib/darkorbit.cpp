@@ -1,9 +1,13 @@
 #include "darkorbit.h"
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <iostream>
 #include <sstream>
 
 #include "disassembler.h"
+#include "bytecode_search.h"
+#include "pool_index.h"
 #include "memory.h"
 #include "offsets.h"
 
@@ -11,123 +15,293 @@
 #define TAG_NUMBER(val) (uintptr_t(val) << 3) | 6
 
 
-// Proxy flash calls to our handlers
+// Proxy flash calls to our handlers. The original procs are called directly, the method is
+// only patched again when the AVM rebinds it (verification, JIT compilation).
 uintptr_t hook_proxy(avm::MethodEnv *env, uint32_t argc, uintptr_t *argv)
 {
-    auto &hook = Darkorbit::get().get_hooks()[env->method_info->id];
-
-    hook.method = env;
+    // The coercing invoker calls back into env->method_proc, which is us, with the receiver
+    // unboxed and the same argc. Only that callback is a reentry and clears the mark. A call of
+    // the method from AS3 while the arguments are coerced (valueOf, toString) comes with a
+    // boxed receiver or through the JIT with another one, and goes through the handlers.
+    struct Invoking
+    {
+        avm::MethodEnv *env;
+        Atom object;
+        uint32_t argc;
+    };
+    static thread_local Invoking invoking { };
+
+    auto &darkorbit = Darkorbit::get();
+    int32_t id = env->method_info->id;
+    bool reentered = invoking.env == env && argv[0] == invoking.object && argc == invoking.argc;
+    if (reentered)
+    {
+        invoking = { };
+    }
+    else if (auto *hook = darkorbit.find_hook(id))
+    {
+        hook->handler(hook->ctx, env, argc, argv);
+    }
 
-    // Restore invokers
-    hook.restore();
+    // The handler may have added or removed hooks, which invalidates the entry
+    auto *hook = darkorbit.find_hook(id);
+    if (!hook)
+    {
+        // Removed, the original procs are back in place
+        Atom this_object = argv[0];
+        return !(this_object & 7)
+            ? env->method_info->method_proc(env, argc, argv)
+            : env->method_info->invoker(env, argc, argv);
+    }
 
-    hook.handler(env, argc, argv);
+    if (!hook->method)
+    {
+        hook->method = env;
+    }
 
-    // Call original
     uintptr_t r = 0;
     Atom this_object = argv[0];
-    if (!(this_object & 7))
+    if (reentered)
     {
-        r = env->method_info->method_proc(env, argc, argv);
+        // the invoker came in through env->method_proc, continue with the one it replaced
+        r = hook->envproc(env, argc, argv);
+    }
+    else if (!(this_object & 7))
+    {
+        r = hook->infoproc(env, argc, argv);
     }
     else
     {
-        r = env->method_info->invoker(env, argc, argv);
+        auto prev = invoking;
+        invoking = { env, this_object & ~Atom(7), argc };
+        r = hook->invoker(env, argc, argv);
+        invoking = prev;
+    }
+
+    if ((hook = darkorbit.find_hook(id)))
+    {
+        auto *info = env->method_info;
+        if (env->method_proc != hook_proxy || info->method_proc != hook_proxy || info->invoker != hook_proxy)
+        {
+            darkorbit.rebind_hook(*hook, env);
+        }
+
+        if (hook->post_handler && !reentered)
+        {
+            hook->post_handler(hook->ctx, env, argc, argv);
+        }
     }
 
-    // Save potentially new invokers
-    if (env->method_proc != hook.envproc)
+    return r;
+}
+
+void Darkorbit::rebind_hook(FlashHook &hook, avm::MethodEnv *env)
+{
+    // Save the new invokers the avm installed and patch the method again
+    auto *info = env->method_info;
+
+    if (env->method_proc != hook_proxy)
     {
         hook.envproc = env->method_proc;
     }
 
-    if (hook.infoproc != env->method_info->method_proc)
+    if (info->method_proc != hook_proxy)
     {
-        hook.infoproc = env->method_info->method_proc;
+        hook.infoproc = info->method_proc;
     }
 
-    if (hook.invoker != env->method_info->invoker)
+    if (info->invoker != hook_proxy)
     {
-        hook.invoker = env->method_info->invoker;
+        hook.invoker = info->invoker;
     }
 
-    // Reinstall hook
     env->method_proc = hook_proxy;
-    env->method_info->method_proc = hook_proxy;
-    env->method_info->invoker = hook_proxy;
-
-    return r;
+    info->method_proc = hook_proxy;
+    info->invoker = hook_proxy;
 }
 
-void Darkorbit::hook_flash_function(avm::MethodEnv *method, MyInvoke_t handler)
+Darkorbit::FlashHook &Darkorbit::add_hook(int32_t id)
 {
-    FlashHook hook;
+    if (static_cast<size_t>(id) >= m_hooks.size())
+    {
+        m_hooks.resize(id + 1);
+    }
 
-    auto mit = m_hooks.find(method->method_info->id);
-    if (mit != m_hooks.end())
+    auto &hook = m_hooks[id];
+    if (hook.installed())
     {
-        mit->second.restore();
+        hook.restore();
+    }
+    else
+    {
+        m_hook_ids.push_back(id);
     }
 
+    hook = FlashHook { };
+    return hook;
+}
+
+void Darkorbit::hook_flash_function(avm::MethodEnv *method, HookHandler_t handler, void *ctx)
+{
+    FlashHook &hook = add_hook(method->method_info->id);
+
     hook.envproc = method->method_proc;
     hook.infoproc = method->method_info->method_proc;
     hook.invoker = method->method_info->invoker;
     hook.handler = handler;
+    hook.ctx = ctx;
     hook.method = method;
 
-    m_hooks[method->method_info->id] = hook;
-
     method->method_proc = hook_proxy;
     method->method_info->method_proc = hook_proxy;
     method->method_info->invoker = hook_proxy;
 
 }
-void Darkorbit::hook_flash_function(avm::MethodInfo *method, MyInvoke_t handler)
+void Darkorbit::hook_flash_function(avm::MethodInfo *method, HookHandler_t handler, void *ctx, HookHandler_t post_handler)
 {
-    FlashHook hook;
-
-    auto mit = m_hooks.find(method->id);
-    if (mit != m_hooks.end())
-    {
-        mit->second.restore();
-    }
+    FlashHook &hook = add_hook(method->id);
 
     hook.envproc = method->method_proc;
     hook.infoproc = method->method_proc;
     hook.invoker = method->invoker;
     hook.handler = handler;
+    hook.post_handler = post_handler;
+    hook.ctx = ctx;
     hook.method_info = method;
 
-    m_hooks[method->id] = hook;
-
     method->method_proc = hook_proxy;
     method->invoker = hook_proxy;
 
 }
 
 // maybe use a global callback thingy to dispatch jit stuff
-void Darkorbit::notify_jit(avm::MethodInfo *method)
+Darkorbit::Darkorbit()
 {
-    if (!m_installed && method->name().find("autoStartEnabled") != std::string::npos)
+    register_jit_hook("autoStartEnabled", false, true, [] (void *ctx, avm::MethodEnv *env, uint32_t argc, uintptr_t *argv)
+    {
+        static_cast<Darkorbit *>(ctx)->install(avm::remove_kind(argv[0]));
+    }, this);
+}
+
+void Darkorbit::register_jit_hook(std::string_view pattern, bool exact, bool before_install, HookHandler_t handler, void *ctx)
+{
+    auto index = static_cast<int32_t>(m_jit_hooks.size());
+    m_jit_hooks.push_back(JitHook { avm::intern(pattern), exact, before_install, handler, ctx });
+
+    if (exact)
     {
-        hook_flash_function(method, [this] (avm::MethodEnv *env, uint32_t argc, uintptr_t *argv)
+        m_jit_exact.emplace(m_jit_hooks.back().pattern, index);
+    }
+    else
+    {
+        m_jit_substr.add(pattern, index);
+    }
+
+    if (!before_install)
+    {
+        m_jit_after_install++;
+    }
+
+    // resolved tables no longer cover every request
+    m_jit_resolved.clear();
+}
+
+int32_t Darkorbit::match_jit_hook(std::string_view name) const
+{
+    auto it = m_jit_exact.find(name);
+    if (it != m_jit_exact.end())
+    {
+        return it->second;
+    }
+
+    // first registered substring hook occurring in the name
+    return m_jit_substr.find(name);
+}
+
+int32_t Darkorbit::match_jit_hook(avm::MethodInfo *method)
+{
+    // only the name table, a full index of every jitted library pool would cost tick time
+    // and slots the game pool needs
+    PoolIndex *index = PoolIndex::request(method->pool, false);
+    if (!index || !index->names_ready())
+    {
+        // name table still building, match this method alone
+        return match_jit_hook(method->name());
+    }
+
+    auto resolved = std::find_if(m_jit_resolved.begin(), m_jit_resolved.end(), [index] (const ResolvedJitHooks &r)
+    {
+        return r.pool == index->pool();
+    });
+
+    if (resolved == m_jit_resolved.end())
+    {
+        // every name of the pool is matched once, later lookups are by id only
+        resolved = m_jit_resolved.insert(m_jit_resolved.end(), ResolvedJitHooks { index->pool(), { } });
+        for (size_t id = 0; id < index->method_count(); id++)
         {
-            install(avm::remove_kind(argv[0]));
-            return 0L;
-        });
+            if (auto *entry = index->method_name(id))
+            {
+                int32_t hook = match_jit_hook(entry->name);
+                if (hook >= 0)
+                {
+                    resolved->by_id.emplace(static_cast<int32_t>(id), hook);
+                }
+            }
+        }
+    }
+
+    auto it = resolved->by_id.find(method->id);
+    return (it != resolved->by_id.end()) ? it->second : -1;
+}
+
+void Darkorbit::notify_jit(avm::MethodInfo *method)
+{
+    // once installed only hooks without before_install can fire
+    if (m_jit_hooks.empty() || (m_installed && !m_jit_after_install))
+    {
+        return;
+    }
+
+    // there is no timer tick to build the indices before install, a small slice per jit does
+    constexpr size_t JIT_INDEX_BUDGET = 256;
+    PoolIndex::step(JIT_INDEX_BUDGET);
+
+    int32_t index = match_jit_hook(method);
+    if (index < 0)
+    {
+        return;
+    }
+
+    const JitHook &hook = m_jit_hooks[index];
+    if (!hook.before_install || !m_installed)
+    {
+        hook_flash_function(method, hook.handler, hook.ctx);
     }
 }
 
 void Darkorbit::notify_freechunk(uintptr_t chunk)
 {
-    // Clear parsed-traits cache because VM memory regions may be freed/recycled
-    avm::clear_traits_cache();
+    // Only entries keyed by objects inside the freed chunk can go stale
+    avm::evict_caches(chunk);
+    PoolIndex::evict(chunk);
+    BytecodeSearch::Evict(chunk);
+    {
+        std::lock_guard<std::mutex> lock(m_signature_mutex);
+        m_signature_cache.evict(chunk);
+    }
+
+    m_jit_resolved.erase(std::remove_if(m_jit_resolved.begin(), m_jit_resolved.end(), [chunk] (const ResolvedJitHooks &r)
+    {
+        return (reinterpret_cast<uintptr_t>(r.pool) & ~0xfffULL) == chunk;
+    }), m_jit_resolved.end());
 
-    for (auto &[id, hook] : m_hooks)
+    for (int32_t id : m_hook_ids)
     {
-        if ((reinterpret_cast<uintptr_t>(hook.method) & ~0xfff) == chunk)
+        if ((reinterpret_cast<uintptr_t>(m_hooks[id].method) & ~0xfff) == chunk)
         {
             uninstall();
+            break;
         }
     }
 }
@@ -136,39 +310,22 @@ std::unordered_map<uint32_t, game::Ship *> Darkorbit::get_ships()
 {
     std::unordered_map<uint32_t, game::Ship *> r;
 
-    auto ships = m_screen_manager->get_at<uintptr_t>(0x100, 0x28);
-    auto elements = memory::read<uintptr_t>(ships + 0x30);
-    auto size = memory::read<uint32_t>(ships + 0x38);
+    auto *ships = m_screen_manager->get_at<avm::ScriptObject *>(0x100, 0x28);
 
-    for (size_t i = 0; i < size; i++)
+    avm::for_each_element(ships, avm::VECTOR_LAYOUT, [&r] (uintptr_t element)
     {
-        auto *ship = avm::remove_kind(memory::read<game::Ship *>(elements + 0x10 + i * 8));
+        auto *ship = reinterpret_cast<game::Ship *>(element);
         if (ship && flash_stuff::hasproperty(ship, "pet"))
         {
             r[ship->id] = ship;
         }
-    }
+    });
     return r;
 }
 
-std::future<uintptr_t> Darkorbit::call_sync(const std::function<uintptr_t()> &f)
-{
-    std::scoped_lock lk { m_call_mut };
-    // push the task into the vector, then return its future in a portable way
-    m_async_calls.emplace_back(std::packaged_task<uintptr_t()>(f));
-    auto &task = m_async_calls.back();
-    std::future<uintptr_t> fut = task.get_future();
-    return fut;
-}
-
 void Darkorbit::handle_async_calls(avm::MethodEnv *env, uint32_t argc, uintptr_t *argv)
 {
-    std::scoped_lock lk { m_call_mut };
-    for (auto &task : m_async_calls)
-    {
-        task();
-    }
-    m_async_calls.clear();
+    m_async_calls.run_pending();
 }
 
 bool Darkorbit::mouse_click(int x, int y, int button)
@@ -226,16 +383,38 @@ bool Darkorbit::refine_ore(uint32_t ore, uint32_t amount)
     {
         if (!m_refine_multiname)
         {
-            auto disass = Disassembler::Disassemble(refinement->vtable->methods[20]->method_info);
-            for (uint32_t &xref : disass.GetXrefs())
+            avm::MethodInfo *method = refinement->vtable->methods[20]->method_info;
+
+            auto check_xref = [this] (uint32_t xref)
             {
                 auto *mn = m_const_pool->get_multiname(xref);
                 if (mn && mn->ns->get_uri().find(".com.module") != std::string::npos)
                 {
                     m_refine_multiname = xref;
                     utils::log("[+] Found multiname: {}::{} ffs\n", mn->ns->get_uri(), mn->get_name());
-                    break;
+                    return true;
                 }
+                return false;
+            };
+
+            PoolIndex *index = PoolIndex::find(method->pool);
+            if (index && index->xrefs_ready())
+            {
+                for (uint32_t xref : index->method_xrefs(method->id))
+                {
+                    if (check_xref(xref))
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                Disassembler::Visit(method->abc_code, [&check_xref] (const AbcInstruction &inst)
+                {
+                    uint32_t xref;
+                    return Disassembler::GetXref(inst, &xref) && check_xref(xref);
+                });
             }
         }
 
@@ -263,7 +442,7 @@ bool Darkorbit::refine_ore(uint32_t ore, uint32_t amount)
     return true;
 }
 
-bool Darkorbit::use_item(const std::string &name, uint8_t type, uint8_t bar)
+bool Darkorbit::use_item(std::string_view name, uint8_t type, uint8_t bar)
 {
     avm::String *name_str = create_string(name);
 
@@ -275,12 +454,12 @@ bool Darkorbit::use_item(const std::string &name, uint8_t type, uint8_t bar)
     if (!m_item_prop_mn)
     {
         auto traits = instance->vtable->traits->parse_traits();
-        for (const auto &slot : traits.get_slots())
+        for (const auto *slot : traits->get_slots())
         {
-            avm::Multiname *type_mn = m_const_pool->get_multiname(slot.type_id);
-            if (type_mn && type_mn->get_name() == "String")
+            avm::Multiname *type_mn = m_const_pool->get_multiname(slot->type_id);
+            if (type_mn && type_mn->name_equals("String"))
             {
-                m_item_prop_mn = slot.name_index;
+                m_item_prop_mn = slot->name_index;
                 break;
             }
         }
@@ -304,7 +483,7 @@ bool Darkorbit::use_item(const std::string &name, uint8_t type, uint8_t bar)
     return false;
 }
 
-bool Darkorbit::send_notification(const std::string &name, const std::vector<Atom> &args)
+bool Darkorbit::send_notification(std::string_view name, uint32_t argc, const Atom *argv)
 {
     utils::log("[*] Send notification {}\n", name);
 
@@ -312,7 +491,7 @@ bool Darkorbit::send_notification(const std::string &name, const std::vector<Ato
 
     // no need to cache these, ref count is not increased
     auto *arg_array = reinterpret_cast<avm::Array *>(
-        flash_stuff::newarray(facade->vtable->methods[0], static_cast<uint32_t>(args.size()), const_cast<Atom *>(args.data())));
+        flash_stuff::newarray(facade->vtable->methods[0], argc, const_cast<Atom *>(argv)));
     avm::String *notification = create_string("MapAssetNotificationTRY_TO_SELECT_MAPASSET");
 
     facade->call(8, notification, (uintptr_t)arg_array | 1);
@@ -322,54 +501,456 @@ bool Darkorbit::send_notification(const std::string &name, const std::vector<Ato
 
 int Darkorbit::check_method_signature(avm::ScriptObject *obj, int methodIdx, bool methodName, const std::string &signature)
 {
-    if (obj) {
-        avm::MethodEnv *method = obj->vtable->methods[methodIdx];
-        if (method && method->method_info) {
-            std::string flashSignature = get_method_signature(method->method_info, methodName);
+    SignatureCheck check { obj, static_cast<uint32_t>(methodIdx), methodName, utils::fnv1a(signature) };
 
-            utils::log("Signature: {} == {}\n", signature, flashSignature);
-            return !flashSignature.empty() && flashSignature == signature;
+    int32_t result = -1;
+    check_method_signatures(&check, 1, &result);
+
+    if (result == 0)
+    {
+        avm::MethodEnv *method = obj->vtable->get_method(methodIdx);
+        utils::log("Signature: {} != {}\n", signature, get_method_signature(method->method_info, methodName));
+    }
+    return result;
+}
+
+void Darkorbit::check_method_signatures(const SignatureCheck *checks, size_t count, int32_t *results)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const SignatureCheck &check = checks[i];
+        results[i] = -1;
+
+        if (check.object)
+        {
+            avm::MethodEnv *method = check.object->vtable->get_method(check.index);
+            if (method && method->method_info)
+            {
+                uint64_t hash = get_signature_hash(method->method_info, check.method_name);
+                results[i] = hash != 0 && hash == check.hash;
+            }
         }
     }
+}
+
+int Darkorbit::find_method(avm::ScriptObject *obj, const std::string &name, bool method_name, const std::string &signature)
+{
+    if (!obj)
+    {
+        return -1;
+    }
+
+    uint32_t slots[16];
+    size_t count = std::min(obj->vtable->find_methods(name, slots, std::size(slots)), std::size(slots));
+    uint64_t hash = utils::fnv1a(signature);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (signature.empty())
+        {
+            return slots[i];
+        }
+
+        avm::MethodEnv *method = obj->vtable->get_method(slots[i]);
+        if (method && method->method_info && get_signature_hash(method->method_info, method_name) == hash)
+        {
+            return slots[i];
+        }
+    }
+
+    return -1;
+}
+
+int Darkorbit::find_method_by_pattern(avm::ScriptObject *obj, const std::string &pattern_text)
+{
+    BytecodePattern pattern(pattern_text);
+    if (!obj || !pattern.valid())
+    {
+        return -1;
+    }
+
+    // the matching ids of a pool are searched once per pattern, a slot is then a lookup
+    avm::PoolObject *pool = nullptr;
+    std::vector<int32_t> ids;
+    size_t budget = PATTERN_BUDGET;
+
+    for (size_t slot = 0; slot < obj->vtable->method_count(); slot++)
+    {
+        avm::MethodEnv *method = obj->vtable->get_method(slot);
+        avm::MethodInfo *info = method ? method->method_info : nullptr;
+        if (!info || !info->pool)
+        {
+            continue;
+        }
+
+        if (info->pool != pool)
+        {
+            pool = info->pool;
+            if (!BytecodeSearch::FindMethods(pool, pattern, budget, &ids))
+            {
+                return PATTERN_PENDING;
+            }
+        }
 
+        if (std::binary_search(ids.begin(), ids.end(), info->id))
+        {
+            return static_cast<int>(slot);
+        }
+    }
     return -1;
 }
 
+static Darkorbit::CallValue decode_atom(Atom atom)
+{
+    using Value = Darkorbit::CallValue;
+    Value result;
+
+    uintptr_t ptr = atom & ~7;
+    switch (atom & 7)
+    {
+        case 1: // object
+        case 3: // namespace
+            result.type = ptr ? Value::OBJECT : Value::NULL_VALUE;
+            result.value = ptr;
+            break;
+        case 2:
+            if ((result.type = ptr ? Value::STRING : Value::NULL_VALUE) == Value::STRING)
+            {
+                result.value = ptr;
+                result.string = reinterpret_cast<avm::String *>(ptr)->read();
+            }
+            break;
+        case 4: // undefined
+            result.type = Value::UNDEFINED;
+            break;
+        case 5:
+            result.type = Value::BOOLEAN;
+            result.value = (atom >> 3) & 1;
+            break;
+        case 6:
+            result.type = Value::INT;
+            result.value = static_cast<uint64_t>(static_cast<int64_t>(atom) >> 3);
+            break;
+        case 7:
+            result.type = Value::NUMBER;
+            std::memcpy(&result.value, reinterpret_cast<const void *>(ptr), sizeof(double));
+            break;
+        default:
+            result.type = atom ? Value::OBJECT : Value::NULL_VALUE;
+            result.value = atom;
+            break;
+    }
+    return result;
+}
+
+Darkorbit::CallValue Darkorbit::call_decoded(avm::ScriptObject *obj, uint32_t index, uint32_t argc, const uintptr_t *argv)
+{
+    CallValue result;
+
+    avm::MethodEnv *env = obj ? obj->vtable->get_method(index) : nullptr;
+    if (!env)
+    {
+        return result;
+    }
+
+    avm::MethodSignature *ms = flash_stuff::get_method_signature(env->method_info);
+    avm::BuiltinType type = ms ? get_builtin_type(ms->_returnTraits) : avm::BUILTIN_any;
+
+    // the native return value depends on the declared type, Number comes back in xmm0
+    if (type == avm::BUILTIN_number)
+    {
+        double number = obj->call_method<double>(index, argc, argv);
+        result.type = CallValue::NUMBER;
+        std::memcpy(&result.value, &number, sizeof(number));
+        return result;
+    }
+
+    uintptr_t raw = obj->call_method(index, argc, argv);
+    switch (type)
+    {
+        case avm::BUILTIN_any:
+        case avm::BUILTIN_object:
+            return decode_atom(raw);
+        case avm::BUILTIN_void:
+            break;
+        case avm::BUILTIN_boolean:
+            result.type = CallValue::BOOLEAN;
+            result.value = (raw & 0xff) != 0;
+            break;
+        case avm::BUILTIN_int:
+            result.type = CallValue::INT;
+            result.value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(raw)));
+            break;
+        case avm::BUILTIN_uint:
+            result.type = CallValue::UINT;
+            result.value = static_cast<uint32_t>(raw);
+            break;
+        case avm::BUILTIN_string:
+            result.type = raw ? CallValue::STRING : CallValue::NULL_VALUE;
+            result.value = raw;
+            if (raw)
+            {
+                result.string = reinterpret_cast<avm::String *>(raw)->read();
+            }
+            break;
+        default:
+            result.type = raw ? CallValue::OBJECT : CallValue::NULL_VALUE;
+            result.value = raw;
+            break;
+    }
+    return result;
+}
+
+// Multiname of the trait declaring name on the class or one of its bases, read from the
+// declaring class's own pool so it carries that trait's namespace. nullptr if nothing declares
+// it, getproperty would throw. For set only slots and setters count, type is what they take.
+// declared tells whether any trait of the chain has that name.
+static avm::Multiname *resolve_property(avm::Traits *traits, std::string_view name, bool set, std::string *type,
+                                        bool *declared)
+{
+    for (; traits; traits = traits->base)
+    {
+        if (!traits->traits_pos || traits->pos_type != 0)
+        {
+            continue;
+        }
+
+        auto parsed = traits->parse_traits();
+        const avm::MyTrait *found = parsed->find(name);
+        *declared |= found != nullptr;
+        if (found && set)
+        {
+            // A getter may come with a setter here or further down the chain
+            found = nullptr;
+            for (const auto &trait : parsed->traits)
+            {
+                if (trait.name != name || trait.kind == avm::TRAIT_Getter)
+                {
+                    continue;
+                }
+                if (trait.kind != avm::TRAIT_Slot && trait.kind != avm::TRAIT_Setter)
+                {
+                    return nullptr; // const, method, class or function
+                }
+                found = &trait;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            continue;
+        }
+
+        // "" if the type can not be resolved, only null fits then
+        if (set && found->kind == avm::TRAIT_Slot)
+        {
+            avm::Multiname *type_mn = found->type_id ? traits->pool->get_multiname(found->type_id) : nullptr;
+            *type = !found->type_id ? "*" : type_mn ? type_mn->get_name() : "";
+        }
+        else if (set && found->id >= 0 && static_cast<size_t>(found->id) < traits->pool->method_count())
+        {
+            avm::MethodSignature *ms = flash_stuff::get_method_signature(traits->pool->get_method(found->id));
+            if (ms && ms->param_count >= 1)
+            {
+                avm::Traits *param = ms->paramTraits(1); // 0 is the receiver
+                *type = param ? param->name() : "*";
+            }
+        }
+        return traits->pool->get_multiname(found->name_index);
+    }
+    return nullptr;
+}
+
+// Public qname of the pool for a dynamic property, nullptr if the pool has none
+static avm::Multiname *public_multiname(avm::PoolObject *pool, std::string_view name)
+{
+    avm::Multiname *mn = pool->find_multiname(name);
+    if (!mn || (mn->flags & (0x04 | 0x08 | 0x10)) || !mn->ns) // RTNS, RTNAME, NSSET
+    {
+        return nullptr;
+    }
+    return mn->ns->type() == avm::Namespace::NS_Public ? mn : nullptr;
+}
+
+// Whether setproperty coerces value to the slot or setter type without a TypeError. Primitive
+// types take any primitive, class types null or an instance of the class or one of its
+// subclasses. Interfaces and parameterized types only take null.
+static bool fits_slot_type(Atom value, const std::string &type)
+{
+    bool object = (value & 7) == 1;
+    if (type == "*" || type == "Object" || (object && !(value & ~7)) || value == 4) // null, undefined
+    {
+        return true;
+    }
+
+    if (type == "int" || type == "uint" || type == "Number" || type == "Boolean" || type == "String")
+    {
+        return !object;
+    }
+
+    if (!object)
+    {
+        return false;
+    }
+
+    auto *obj = reinterpret_cast<avm::ScriptObject *>(value & ~7);
+    for (avm::Traits *traits = obj->vtable->traits; traits; traits = traits->base)
+    {
+        if (traits->name() == type)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Darkorbit::bulk_property(bool set, const uintptr_t *objects, size_t object_count,
+                              const std::vector<std::string> &names, uint64_t *values)
+{
+    if (!m_const_pool)
+    {
+        return false;
+    }
+
+    // Objects of one class usually come in a row, resolve the names again once it changes
+    avm::Traits *resolved_for = nullptr;
+    std::vector<avm::Multiname *> multinames(names.size());
+    std::vector<std::string> types(names.size());
+
+    for (size_t i = 0; i < object_count; i++)
+    {
+        auto *obj = avm::remove_kind(reinterpret_cast<avm::ScriptObject *>(objects[i]));
+
+        if (obj && obj->vtable->traits != resolved_for)
+        {
+            resolved_for = obj->vtable->traits;
+            for (size_t j = 0; j < names.size(); j++)
+            {
+                bool declared = false;
+                types[j].clear();
+                multinames[j] = resolve_property(resolved_for, names[j], set, &types[j], &declared);
+
+                // Dynamic classes keep undeclared names in their hashtable
+                if (!declared && resolved_for->hashTableOffset)
+                {
+                    multinames[j] = public_multiname(m_const_pool, names[j]);
+                    types[j] = "*";
+                }
+            }
+        }
+
+        for (size_t j = 0; j < names.size(); j++)
+        {
+            uint64_t &value = values[i * names.size() + j];
+
+            if (!obj || !multinames[j] || (set && !fits_slot_type(value, types[j])))
+            {
+                value = set ? 0 : 4; // undefined
+                continue;
+            }
+
+            if (set)
+            {
+                flash_stuff::setproperty(obj, multinames[j], value);
+                value = 1;
+            }
+            else
+            {
+                value = flash_stuff::getproperty(reinterpret_cast<Atom>(obj) | 1, multinames[j], obj->vtable);
+            }
+        }
+    }
+    return true;
+}
+
+avm::ClassLayoutRef Darkorbit::get_layout(avm::ScriptObject *obj, const std::string &class_name)
+{
+    avm::Traits *traits = nullptr;
+
+    if (!class_name.empty())
+    {
+        if (auto *closure = m_main ? m_main->get_abcenv()->finddef(class_name) : nullptr)
+        {
+            traits = closure->vtable->ivtable->traits;
+        }
+    }
+    else if (obj)
+    {
+        traits = obj->vtable->traits;
+    }
+
+    return traits ? traits->get_layout() : nullptr;
+}
+
+std::vector<avm::ClassClosure *> Darkorbit::finddef(const std::vector<std::string> &names)
+{
+    if (!m_main)
+    {
+        return std::vector<avm::ClassClosure *>(names.size(), nullptr);
+    }
+    return m_main->get_abcenv()->finddef(names);
+}
+
 std::string Darkorbit::get_method_signature(avm::MethodInfo *mi, bool method_name)
 {
-    std::stringstream ss;
+    std::string sig;
 
     avm::MethodSignature *ms = flash_stuff::get_method_signature(mi);
     if (ms) {
-        ss << get_builtin_type(ms->_returnTraits);
+        sig.reserve(64);
+        sig += std::to_string(get_builtin_type(ms->_returnTraits));
 
         if (method_name) {
-            std::string mn = mi->name();
+            std::string_view mn = mi->name();
             if (mn.empty()) return "";
 
-            ss << "(";
             auto index = mn.find('/');
-            if (index != std::string::npos) {
-                ss << mn.substr(index + 1);
-            } else ss << mn;
-            ss << ")";
+            sig += '(';
+            sig += (index != std::string::npos) ? mn.substr(index + 1) : mn;
+            sig += ')';
         }
 
-        ss << "(";
+        sig += '(';
         for (int i = 0; i <= ms->param_count; i++) {
-            auto bt = get_builtin_type(ms->paramTraits(i));
-
-            ss << bt;
+            sig += std::to_string(get_builtin_type(ms->paramTraits(i)));
             if (i > ms->param_count - ms->optional_count) {
-                ss << "?";
+                sig += '?';
             }
         }
+        sig += ')';
 
-        ss << ")" << ms->param_count << ms->optional_count << ms->rest_offset << ms->max_stack
-        << ms->local_count << ms->max_scope << ms->frame_size << ms->isNative << ms->allowExtraArgs;
+        for (int value : { ms->param_count, ms->optional_count, ms->rest_offset, ms->max_stack,
+                           ms->local_count, ms->max_scope, ms->frame_size })
+        {
+            sig += std::to_string(value);
+        }
+        sig += ms->isNative ? '1' : '0';
+        sig += ms->allowExtraArgs ? '1' : '0';
     }
 
-    return ss.str();
+    return sig;
+}
+
+uint64_t Darkorbit::get_signature_hash(avm::MethodInfo *mi, bool method_name)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_signature_mutex);
+        if (auto *cached = m_signature_cache.find(mi))
+        {
+            return (*cached)[method_name];
+        }
+    }
+
+    std::array<uint64_t, 2> hashes { };
+    for (int i = 0; i < 2; i++)
+    {
+        std::string sig = get_method_signature(mi, i);
+        hashes[i] = sig.empty() ? 0 : utils::fnv1a(sig);
+    }
+
+    std::lock_guard<std::mutex> lock(m_signature_mutex);
+    return m_signature_cache.insert(mi, hashes)[method_name];
 }
 
 bool Darkorbit::install(uintptr_t main_app_address)
@@ -391,6 +972,9 @@ bool Darkorbit::install(uintptr_t main_app_address)
     abc_env              = memory::read<avm::AbcEnv *>(vtable_scope + 0x10);
     m_const_pool         = abc_env->pool;
 
+    // names, multinames and xrefs of the game pool are indexed a slice per tick from here on
+    PoolIndex::request(m_const_pool);
+
 
     avm::Multiname *proxy_mn = abc_env->pool->find_multiname("ItemsControlMenuProxy");
 
@@ -404,8 +988,19 @@ bool Darkorbit::install(uintptr_t main_app_address)
     else if (auto *menu_proxy = menu_proxy_obj->get_at<avm::ClassClosure *>(0x20))
     {
         avm::ScriptObject *proxy_object = menu_proxy->construct();
-        avm::MethodEnv *send_action     = proxy_object->vtable->get_methods().at(36);
-        uint32_t packet_mn              = send_action->method_info->get_params()[0];
+        avm::MethodEnv *send_action     = proxy_object->vtable->get_method(36);
+        if (!send_action)
+        {
+            utils::log("[!] Failed to find ItemsControlMenuProxy send action!!\n");
+            return false;
+        }
+        std::vector<uint32_t> params    = send_action->method_info->get_params();
+        if (params.empty())
+        {
+            utils::log("[!] Failed to read ItemsControlMenuProxy send action params!!\n");
+            return false;
+        }
+        uint32_t packet_mn              = params[0];
         avm::Multiname *mn              = m_const_pool->get_multiname(packet_mn);
         avm::ScriptObject *global       = flash_stuff::finddef(send_action, mn);
 
@@ -417,11 +1012,24 @@ bool Darkorbit::install(uintptr_t main_app_address)
         return false;
     }
 
-    if (auto timer_method = m_screen_manager->vtable->methods[34]->method_info)
+    avm::MethodEnv *timer_env = m_screen_manager->vtable->get_method(34);
+    if (auto timer_method = timer_env ? timer_env->method_info : nullptr)
     {
-        using namespace std::placeholders;
         utils::log("[+] Found gui timer method at {x}\n", reinterpret_cast<uintptr_t>(timer_method));
-        hook_flash_function(timer_method, std::bind(&Darkorbit::handle_async_calls, this, _1, _2, _3));
+        hook_flash_function(timer_method, [] (void *ctx, avm::MethodEnv *env, uint32_t argc, uintptr_t *argv)
+        {
+            static_cast<Darkorbit *>(ctx)->handle_async_calls(env, argc, argv);
+        }, this, [] (void *ctx, avm::MethodEnv *, uint32_t, uintptr_t *)
+        {
+            // end of the tick, the frame sees everything the game updated in it
+            static_cast<Darkorbit *>(ctx)->m_tick_area.update();
+            static_cast<Darkorbit *>(ctx)->m_call_cache.next_generation();
+            avm::next_tick();
+
+            // nothing holds a pool index across ticks
+            PoolIndex::collect();
+            PoolIndex::step(PoolIndex::TICK_BUDGET);
+        });
     }
     else
     {
@@ -437,6 +1045,7 @@ bool Darkorbit::install(uintptr_t main_app_address)
     {
         // ....
     }
+    m_tick_area.attach(m_ipc.TickMemory(), m_ipc.TickSize());
 
     return (m_installed = true);
 }
@@ -445,15 +1054,28 @@ bool Darkorbit::uninstall()
 {
     utils::log("[-] Uninstalling...\n");
 
-    for (auto &[id, hook] : m_hooks)
+    for (int32_t id : m_hook_ids)
     {
-        hook.restore();
+        m_hooks[id].restore();
     }
     m_hooks.clear();
+    m_hook_ids.clear();
+
+    avm::clear_caches();
+    BytecodeSearch::ClearCache();
+    PoolIndex::clear();
+    {
+        std::lock_guard<std::mutex> lock(m_signature_mutex);
+        m_signature_cache.clear();
+    }
+    m_jit_resolved.clear();
 
     m_refine_multiname = 0;
     m_item_prop_mn = 0;
 
+    m_tick_area.clear();
+    m_tick_area.attach(nullptr, 0);
+    m_call_cache.next_generation();
 
     m_ipc.Remove();
     m_installed = false;
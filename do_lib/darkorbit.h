@@ -1,19 +1,30 @@
 #ifndef DARKORBIT_H
 #define DARKORBIT_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
-#include <future>
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <functional>
+#include <string_view>
+#include <new>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 
+#include "aho_corasick.h"
 #include "flash_stuff.h"
 #include "utils.h"
 #include "singleton.h"
 #include "ipc.h"
 #include "avm.h"
+#include "async_calls.h"
+#include "call_cache.h"
+#include "tick_area.h"
+#include "page_cache.h"
 
 
 namespace game
@@ -77,18 +88,22 @@ class Darkorbit : public Singleton<Darkorbit>
 {
 public:
 
-    typedef std::function<void(avm::MethodEnv *, uint32_t , uintptr_t *)> MyInvoke_t;
+    typedef void (*HookHandler_t)(void *ctx, avm::MethodEnv *, uint32_t, uintptr_t *);
 
     struct FlashHook
     {
-        avm::MethodInvoke_t envproc;
-        avm::MethodInvoke_t infoproc;
-        avm::MethodInvoke_t invoker;
+        avm::MethodInvoke_t envproc = nullptr;
+        avm::MethodInvoke_t infoproc = nullptr;
+        avm::MethodInvoke_t invoker = nullptr;
 
         avm::MethodEnv *method = nullptr;
         avm::MethodInfo *method_info = nullptr;
 
-        MyInvoke_t handler;
+        HookHandler_t handler = nullptr;
+        HookHandler_t post_handler = nullptr;   // after the original method returned
+        void *ctx = nullptr;
+
+        inline bool installed() const { return handler != nullptr; }
 
         void restore()
         {
@@ -111,10 +126,35 @@ public:
         }
     };
 
-    struct LateHook
+    // Result of a method call decoded on the flash thread, by the declared return type
+    // or by the atom tag for untyped methods
+    struct CallValue
+    {
+        enum Type : uint8_t
+        {
+            UNDEFINED,
+            NULL_VALUE,
+            BOOLEAN,
+            INT,
+            UINT,
+            NUMBER,
+            STRING,
+            OBJECT
+        };
+
+        Type type = UNDEFINED;
+        uint64_t value = 0;     // integer, double bits or the object / string pointer
+        std::string string;
+    };
+
+    // Hook requested up front and installed when a matching method gets jitted
+    struct JitHook
     {
-        avm::MethodInfo *method;
-        MyInvoke_t handler;
+        std::string_view pattern;   // interned
+        bool exact;                 // whole MethodInfo::name(), otherwise a substring of it
+        bool before_install;        // only hooked while not installed
+        HookHandler_t handler;
+        void *ctx;
     };
 
 
@@ -122,7 +162,7 @@ public:
     bool uninstall();
 
 
-    avm::String *create_string(const std::string &s)
+    avm::String *create_string(std::string_view s)
     {
         auto *r = flash_stuff::newstring(m_main->core(), s);
         
@@ -151,28 +191,62 @@ public:
 
     bool refine_ore(uint32_t ore, uint32_t amount);
 
-    bool use_item(const std::string &name, uint8_t type, uint8_t bar);
+    bool use_item(std::string_view name, uint8_t type, uint8_t bar);
 
-    bool send_notification(const std::string &name, const std::vector<Atom> &args);
+    bool send_notification(std::string_view name, uint32_t argc, const Atom *argv);
 
-    void hook_flash_function(avm::MethodEnv *method, MyInvoke_t handler);
+    void hook_flash_function(avm::MethodEnv *method, HookHandler_t handler, void *ctx = nullptr);
 
-    void hook_flash_function(avm::MethodInfo *method_info, MyInvoke_t handler);
+    void hook_flash_function(avm::MethodInfo *method_info, HookHandler_t handler, void *ctx = nullptr,
+                             HookHandler_t post_handler = nullptr);
 
     std::unordered_map<uint32_t, game::Ship *> get_ships();
 
+    void register_jit_hook(std::string_view pattern, bool exact, bool before_install, HookHandler_t handler, void *ctx = nullptr);
+
     void notify_jit(avm::MethodInfo *method);
 
     void notify_freechunk(uintptr_t chunk);
 
-    FlashHook &gethook(uint32_t id) { return m_hooks[id]; };
+    inline FlashHook *find_hook(int32_t id)
+    {
+        if (id < 0 || static_cast<size_t>(id) >= m_hooks.size() || !m_hooks[id].installed())
+        {
+            return nullptr;
+        }
+        return &m_hooks[id];
+    }
+
+    void rebind_hook(FlashHook &hook, avm::MethodEnv *env);
 
-    auto &get_hooks() { return m_hooks; }
+    // Runs f on the flash thread and waits for it. Returns false if no slot was free or the
+    // call did not complete within the timeout.
+    template<typename F>
+    bool call_sync(const F &f, uintptr_t *result = nullptr,
+                   std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        return m_async_calls.call_sync(f, result, timeout);
+    }
 
-    std::future<uintptr_t> call_sync(const std::function<uintptr_t()> &f);
+    template<typename T, typename F>
+    bool call_sync_value(const F &f, T *result,
+                         std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        return m_async_calls.call_sync_value(f, result, timeout);
+    }
 
     void cleanup();
 
+    inline TickArea &tick_area()
+    {
+        return m_tick_area;
+    }
+
+    inline CallCache &call_cache()
+    {
+        return m_call_cache;
+    }
+
     avm::BuiltinType inline get_builtin_type(avm::Traits *traits)
     {
         return traits ? avm::BuiltinType(traits->builtinType) : avm::BUILTIN_any;
@@ -180,7 +254,47 @@ public:
 
     int check_method_signature(avm::ScriptObject *obj, int methodIdx, bool methodName, const std::string &signature);
 
+    struct SignatureCheck
+    {
+        avm::ScriptObject *object;
+        uint32_t index;
+        bool method_name;
+        uint64_t hash;      // utils::fnv1a of the expected signature
+    };
+
+    // Same results as check_method_signature for every entry, compared by hash
+    void check_method_signatures(const SignatureCheck *checks, size_t count, int32_t *results);
+
+    // Slot of the named method in the object's vtable, -1 if missing. A non empty signature
+    // has to match get_method_signature(method, method_name) as well.
+    int find_method(avm::ScriptObject *obj, const std::string &name, bool method_name, const std::string &signature);
+    // Slot of the first method in the object's vtable whose body matches a BytecodePattern, -1 if
+    // none. The search decodes PATTERN_BUDGET bodies per call and returns PATTERN_PENDING until
+    // it is complete, call again (next tick) to continue it.
+    static constexpr int PATTERN_PENDING = -2;
+    static constexpr size_t PATTERN_BUDGET = 2048;
+    int find_method_by_pattern(avm::ScriptObject *obj, const std::string &pattern);
+
     std::string get_method_signature(avm::MethodInfo *mi, bool method_name);
+    // fnv1a of get_method_signature, formatted once per method. 0 if there is no signature
+    uint64_t get_signature_hash(avm::MethodInfo *mi, bool method_name);
+
+    CallValue call_decoded(avm::ScriptObject *obj, uint32_t index, uint32_t argc, const uintptr_t *argv);
+
+    // Gets (values = atoms out) or sets (values = atoms in, 1/0 out) every name on every object,
+    // values is object major. Names are resolved through the trait declaring them on the object's
+    // class or its bases. On dynamic objects undeclared names go through the public qname of the
+    // game's constant pool, so dynamic properties whose name the pool does not hold can't be
+    // reached. Unresolved names, and for set consts, methods, getter only accessors and values
+    // of the wrong slot type, are skipped (undefined / 0).
+    bool bulk_property(bool set, const uintptr_t *objects, size_t object_count,
+                       const std::vector<std::string> &names, uint64_t *values);
+
+    // Slot layout of the object's class, or of the instances of class_name if it is set
+    avm::ClassLayoutRef get_layout(avm::ScriptObject *obj, const std::string &class_name);
+
+    // Class closures of the game's definitions by name, nullptr for names not found
+    std::vector<avm::ClassClosure *> finddef(const std::vector<std::string> &names);
 
 
 
@@ -188,19 +302,45 @@ friend class Singleton;
 
 private:
 
-    Darkorbit() = default;
+    Darkorbit();
     Darkorbit &operator=(const Darkorbit) = delete;
 
     void handle_async_calls(avm::MethodEnv *env, uint32_t argc, uintptr_t *argv) ;
 
+    FlashHook &add_hook(int32_t id);
+
+    int32_t match_jit_hook(std::string_view name) const;
+    int32_t match_jit_hook(avm::MethodInfo *method);
+
+
 
+    // Indexed by method id, m_hook_ids lists the installed entries
+    std::vector<FlashHook> m_hooks;
+    std::vector<int32_t> m_hook_ids;
+
+    // Registered jit hooks, exact names are hashed and substrings matched in one pass
+    std::vector<JitHook> m_jit_hooks;
+    std::unordered_map<std::string_view, int32_t> m_jit_exact;
+    AhoCorasick m_jit_substr;
+    size_t m_jit_after_install = 0;     // hooks that can still fire once installed
+
+    // Per pool: method id -> jit hook, resolved once from the PoolIndex name table
+    struct ResolvedJitHooks
+    {
+        avm::PoolObject *pool;
+        std::unordered_map<int32_t, int32_t> by_id;
+    };
+    std::vector<ResolvedJitHooks> m_jit_resolved;
 
-    std::unordered_map<uint32_t, FlashHook> m_hooks;
+    // Signature hashes without and with the method name
+    std::mutex m_signature_mutex;
+    PageCache<avm::MethodInfo, std::array<uint64_t, 2>> m_signature_cache;
 
-    std::mutex m_call_mut;
-    std::vector<std::packaged_task<uintptr_t()>> m_async_calls;
+    AsyncCalls m_async_calls;
 
     Ipc m_ipc;
+    TickArea m_tick_area;
+    CallCache m_call_cache;
     bool m_installed = false;
 
     uint32_t m_refine_multiname = 0;
@@ -1,21 +1,132 @@
 #ifndef DISASSEMBLER_H
 #define DISASSEMBLER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binary_stream.h"
 #include "instructions.h"
 #include "avm.h"
 
+// Decoded instruction with its operands stored inline. lookupswitch keeps the default
+// offset and the case count, the case offsets are read from the code with case_offset().
 class AbcInstruction
 {
 public:
-    AbcInstruction(ABC::OpCode op, std::vector<int> indexes, size_t pos, size_t inst_size = 1)
-        : opcode(op), operands(indexes), size(inst_size), position(pos)
+    std::string ToString() const;
+
+    inline const ABC::OpInfo &info() const
     {
+        return ABC::Opcodes[static_cast<uint8_t>(opcode)];
     }
 
-    std::string ToString() const;
+    inline int32_t case_offset(uint32_t i) const
+    {
+        BinaryStream cases { case_table };
+        cases.position = i * 3;
+        return cases.read_s24();
+    }
 
-    ABC::OpCode opcode;
-    std::vector<int> operands;
+    ABC::OpCode opcode = ABC::OP_nop;
+    uint8_t operand_count = 0;
+    int32_t operands[ABC::OpInfo::MAX_OPERANDS] = { };
     size_t size = 1, position = 0;
+
+    const uint8_t *case_table = nullptr;
+};
+
+// Streams instructions out of a method body without allocating
+class AbcDecoder
+{
+public:
+    AbcDecoder(const uint8_t *code, size_t length) : m_code { code, code + length }, m_end(length) { }
+
+    // Skips the method body header of MethodInfo::abc_code
+    explicit AbcDecoder(const uint8_t *body) : m_code { body }
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            m_code.read_u32();
+        }
+        m_end = m_code.read_u32();
+        m_code.data += m_code.position;
+        m_code.end = m_code.data + m_end;
+        m_code.position = 0;
+    }
+
+    // False at the end of the code or on an opcode the table does not know
+    bool next(AbcInstruction &inst)
+    {
+        if (m_code.position >= m_end)
+        {
+            return false;
+        }
+
+        size_t start = m_code.position;
+        uint8_t byte = m_code.read<uint8_t>();
+        const ABC::OpInfo &info = ABC::Opcodes[byte];
+
+        if (!info.name)
+        {
+            m_failed = true;
+            m_code.position = m_end;
+            return false;
+        }
+
+        inst.opcode = static_cast<ABC::OpCode>(byte);
+        inst.position = start;
+        inst.operand_count = 0;
+        inst.case_table = nullptr;
+
+        for (uint8_t i = 0; i < info.operand_count; i++)
+        {
+            switch (info.operands[i])
+            {
+                case ABC::Operand::U30:
+                    inst.operands[inst.operand_count++] = static_cast<int32_t>(m_code.read_u30());
+                    break;
+                case ABC::Operand::S24:
+                    inst.operands[inst.operand_count++] = m_code.read_s24();
+                    break;
+                case ABC::Operand::Byte:
+                    inst.operands[inst.operand_count++] = m_code.read<uint8_t>();
+                    break;
+                case ABC::Operand::Dynamic:
+                {
+                    // lookupswitch: case_count + 1 offsets follow the count
+                    uint32_t case_count = m_code.read_u30();
+                    inst.operands[inst.operand_count++] = static_cast<int32_t>(case_count);
+                    inst.case_table = &m_code.data[m_code.position];
+                    m_code.position += (static_cast<size_t>(case_count) + 1) * 3;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        if (!m_code.ok() || m_code.position > m_end)
+        {
+            // operands run past the end of the body
+            m_failed = true;
+            m_code.position = m_end;
+            return false;
+        }
+
+        inst.size = m_code.position - start;
+        return true;
+    }
+
+    inline bool failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    BinaryStream m_code;
+    size_t m_end = 0;
+    bool m_failed = false;
 };
 
 
@@ -34,6 +145,56 @@ public:
         std::vector<AbcInstruction> instructions;
     };
 
+    // Calls f(inst) for every instruction of a method body, returning true from f stops.
+    // Returns false if the body could not be decoded to the end.
+    template<typename F>
+    static bool Visit(const uint8_t *data, F &&f)
+    {
+        AbcDecoder decoder { data };
+        AbcInstruction inst;
+
+        while (decoder.next(inst))
+        {
+            if (f(inst))
+            {
+                return true;
+            }
+        }
+        return !decoder.failed();
+    }
+
+    // Multiname operand of the instructions that reference a type or property by name
+    static inline bool GetXref(const AbcInstruction &inst, uint32_t *xref)
+    {
+        using namespace ABC;
+        switch (inst.opcode)
+        {
+            case OpCode::OP_findpropstrict:
+            case OpCode::OP_constructprop:
+            case OpCode::OP_astype:
+            case OpCode::OP_callsuper:
+            case OpCode::OP_callsupervoid:
+            case OpCode::OP_coerce:
+            case OpCode::OP_finddef:
+            case OpCode::OP_getdescendants:
+            case OpCode::OP_getlex:
+            case OpCode::OP_getsuper:
+            case OpCode::OP_istype:
+            case OpCode::OP_setsuper:
+                *xref = static_cast<uint32_t>(inst.operands[0]);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Xrefs of a method body in one streaming pass, empty if it does not decode
+    static std::vector<uint32_t> GetXrefs(const uint8_t *data);
+
+    inline static std::vector<uint32_t> GetXrefs(avm::MethodInfo *method)
+    {
+        return GetXrefs(method->abc_code);
+    }
 
     static Disassembly Disassemble(const uint8_t *data);
 
@@ -45,4 +206,3 @@ public:
 
 
 #endif /* DISASSEMBLER_H */
-
@@ -37,23 +37,58 @@ typedef avm::MethodSignature *(*get_method_signature_t)(avm::MethodInfo *mi);
 get_method_signature_t get_method_signature_f = nullptr;
 
 
-subhook::Hook *free_chunk_hook = nullptr;
-subhook::Hook *verify_jit_hook = nullptr;
+// Native flash functions we detour. The original is called through the subhook trampoline
+// so the patched code stays in place, removing the hook around the call is only a fallback
+// for prologues subhook can't relocate.
+struct NativeHook
+{
+    const char *name;
+    std::ptrdiff_t offset;
+    void *detour;
+
+    subhook::Hook *hook = nullptr;
+    void *trampoline = nullptr;
+
+    template<typename F, typename ... Args>
+    inline auto call_original(Args ... args)
+    {
+        if (trampoline)
+        {
+            return reinterpret_cast<F *>(trampoline)(args...);
+        }
 
+        subhook::ScopedHookRemove hk(hook);
+        return reinterpret_cast<F *>(hook->GetSrc())(args...);
+    }
+};
+
+void verify_jit(uintptr_t _this, avm::MethodInfo *method, uintptr_t ms, uintptr_t toplevel, avm::AbcEnv *abc_env, uintptr_t osr);
+void free_chunk(uintptr_t _this, uintptr_t chunk);
+
+enum NativeHookId
+{
+    HOOK_VERIFY_JIT,
+    HOOK_FREE_CHUNK
+};
+
+// Indexed by NativeHookId
+NativeHook native_hooks[] =
+{
+    { "verify_jit", offsets::verifyjit,  reinterpret_cast<void *>(verify_jit) },
+    { "free_chunk", offsets::free_chunk, reinterpret_cast<void *>(free_chunk) },
+};
 
 
 void verify_jit(uintptr_t _this, avm::MethodInfo *method, uintptr_t ms, uintptr_t toplevel, avm::AbcEnv *abc_env, uintptr_t osr)
 {
-    subhook::ScopedHookRemove hk(verify_jit_hook);
-    reinterpret_cast<decltype(verify_jit) *>(verify_jit_hook->GetSrc())(_this, method, ms, toplevel, abc_env, osr);
+    native_hooks[HOOK_VERIFY_JIT].call_original<decltype(verify_jit)>(_this, method, ms, toplevel, abc_env, osr);
     Darkorbit::get().notify_jit(method);
 }
 
 void free_chunk(uintptr_t _this, uintptr_t chunk)
 {
-    subhook::ScopedHookRemove hk(free_chunk_hook);
     Darkorbit::get().notify_freechunk(chunk);
-    reinterpret_cast<decltype(free_chunk) *>(free_chunk_hook->GetSrc())(_this, chunk);
+    native_hooks[HOOK_FREE_CHUNK].call_original<decltype(free_chunk)>(_this, chunk);
 }
 
 uintptr_t get_input_param()
@@ -92,9 +127,9 @@ void flash_stuff::mouse_press(int x, int y, int button)
     }
 }
 
-bool flash_stuff::hasproperty(avm::ScriptObject *obj, const std::string &prop_name)
+bool flash_stuff::hasproperty(avm::ScriptObject *obj, std::string_view prop_name)
 {
-    return obj->vtable->traits->parse_traits().has_trait(prop_name);
+    return obj->vtable->traits->parse_traits()->has_trait(prop_name);
 }
 
 uintptr_t flash_stuff::getproperty(uintptr_t obj, avm::Multiname *mm, avm::VTable *vtable)
@@ -117,9 +152,9 @@ uintptr_t flash_stuff::newarray(avm::MethodEnv *env, uint32_t argc, void *argv)
     return newarray_f(env, argc, argv);
 }
 
-avm::String *flash_stuff::newstring(avm::AvmCore *core, const std::string &s)
+avm::String *flash_stuff::newstring(avm::AvmCore *core, std::string_view s)
 {
-    return newstring_f(core, s.data(), -1, 0, 0, 0);
+    return newstring_f(core, s.data(), static_cast<int32_t>(s.size()), 0, 0, 0);
 }
 
 avm::ScriptObject *flash_stuff::finddef(avm::MethodEnv *env, avm::Multiname *mn)
@@ -145,19 +180,24 @@ bool flash_stuff::install()
         return false;
     }
 
-    verify_jit_hook = new subhook::Hook(
-                reinterpret_cast<void *>(base + offsets::verifyjit),
-                reinterpret_cast<void *>(verify_jit),
-                subhook::HookFlags::HookFlag64BitOffset);
-
-    verify_jit_hook->Install();
+    for (auto &native : native_hooks)
+    {
+        native.hook = new subhook::Hook(
+                    reinterpret_cast<void *>(base + native.offset),
+                    native.detour,
+                    subhook::HookFlags(subhook::HookFlag64BitOffset | subhook::HookFlagTrampoline));
 
-    free_chunk_hook = new subhook::Hook(
-                reinterpret_cast<void *>(base + offsets::free_chunk),
-                reinterpret_cast<void *>(free_chunk),
-                subhook::HookFlags::HookFlag64BitOffset);
+        if (!native.hook->Install())
+        {
+            utils::log("[!] Failed to install {} hook\n", native.name);
+            continue;
+        }
 
-    free_chunk_hook->Install();
+        if (!(native.trampoline = native.hook->GetTrampoline()))
+        {
+            utils::log("[!] No trampoline for {}, falling back to unhooking on call\n", native.name);
+        }
+    }
 
     getproperty_f           = reinterpret_cast<getproperty_t>(base + offsets::getproperty);
     setproperty_f           = reinterpret_cast<setproperty_t>(base + offsets::setproperty);
@@ -174,13 +214,12 @@ bool flash_stuff::install()
 
 void flash_stuff::uninstall()
 {
-    if (verify_jit_hook && verify_jit_hook->IsInstalled())
-    {
-        verify_jit_hook->Remove();
-    }
-
-    if (free_chunk_hook && free_chunk_hook->IsInstalled())
+    for (auto &native : native_hooks)
     {
-        free_chunk_hook->Remove();
+        if (native.hook && native.hook->IsInstalled())
+        {
+            native.hook->Remove();
+        }
+        native.trampoline = nullptr;
     }
 }
@@ -1,9 +1,9 @@
 #ifndef INSTRUCTIONS_H
 #define INSTRUCTIONS_H
-#include <map>
-#include <vector>
-#include <string>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <initializer_list>
 
 namespace ABC {
 enum class Operand
@@ -228,26 +228,33 @@ enum OpCode
     OP_wb                   = 0xF8,
     };
 
-class Instruction
+// Static description of an opcode, operands are decoded in order
+struct OpInfo
 {
-public:
-    Instruction(const std::string &name, std::vector<Operand> operands = { }) 
-        : operands(operands), name(name)
+    static constexpr size_t MAX_OPERANDS = 4;
+
+    constexpr OpInfo() = default;
+    constexpr OpInfo(const char *name, std::initializer_list<Operand> ops = { }) : name(name)
     {
+        for (Operand op : ops)
+        {
+            operands[operand_count++] = op;
+        }
     }
 
-    Instruction() = default;
-
-    std::vector<Operand> operands;
-
-    uint32_t ip = 0;
-
-    std::string name;
+    const char *name = nullptr; // nullptr for opcodes the decoder does not know
+    uint8_t operand_count = 0;
+    Operand operands[MAX_OPERANDS] = { };
 };
 
+struct OpDef
+{
+    uint8_t code;
+    OpInfo info;
+};
 
-
-static std::map<uint8_t, Instruction> Instructions
+// Source list, the first entry of an opcode wins
+static constexpr OpDef OpDefs[] =
 {
     //{ 0xEE, { "abs_jump" } },
     { 0xA0, { "add" } },
@@ -366,7 +373,7 @@ static std::map<uint8_t, Instruction> Instructions
     { 0x68, { "initproperty", { Operand::U30 } } },
     { 0xB1, { "instanceof" } },
     { 0xED, { "invalid" } },
-    { 0xB2, { "istype" } },
+    { 0xB2, { "istype", { Operand::U30 } } },
     { 0xB3, { "istypelate" } },
     { 0x10, { "jump", { Operand::S24 } } },
     { 0x08, { "kill", { Operand::U30 } } },
@@ -459,8 +466,23 @@ static std::map<uint8_t, Instruction> Instructions
     { 0xFE, { "verifyop" } },
     { 0xF5, { "verifypass" } },
     { 0xF8, { "wb" } }
+};
 
-    };
+constexpr std::array<OpInfo, 256> make_opcode_table()
+{
+    std::array<OpInfo, 256> table { };
+    for (const OpDef &def : OpDefs)
+    {
+        if (!table[def.code].name)
+        {
+            table[def.code] = def.info;
+        }
+    }
+    return table;
+}
+
+// Indexed by opcode byte
+inline constexpr std::array<OpInfo, 256> Opcodes = make_opcode_table();
 };
 
 
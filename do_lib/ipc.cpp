@@ -2,6 +2,11 @@
 
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/shm.h>
@@ -11,11 +16,14 @@
 #include "darkorbit.h"
 #include "flash_stuff.h"
 #include "memory.h"
+#include "read_script.h"
+#include "utf.h"
 #include "utils.h"
 
-#define MEM_SIZE 1024
-
-using namespace std::chrono_literals;
+#define MESSAGE_SIZE    1024    // responses that do not fit into a message follow it
+#define TICK_OFFSET     0x4000  // TickArea frames
+#define TICK_SIZE       0x10000
+#define MEM_SIZE        (TICK_OFFSET + TICK_SIZE)
 
 union semun
 { 
@@ -38,6 +46,17 @@ enum class MessageType
     KEY_CLICK,
     MOUSE_CLICK,
     CHECK_SIGNATURE,
+    FIND_METHOD,
+    GET_LAYOUT,
+    REGISTER_SCRIPT,
+    UNREGISTER_SCRIPT,
+    REGISTER_READS,
+    UNREGISTER_READS,
+    CALL_CACHE_STATS,
+    BULK_PROPERTY,
+    CHECK_SIGNATURES,
+    FINDDEF,
+    FIND_METHOD_PATTERN,
     NONE
 
 };
@@ -62,6 +81,11 @@ struct FunctionResultMessage
     MessageType type = MessageType::RESULT;
     bool error = false;
     uintptr_t value;
+
+    // decoded calls: Darkorbit::CallValue::Type, strings follow the message
+    uint8_t value_type;
+    uint32_t string_size;
+    bool truncated;     // the string was cut at a character boundary to fit
 };
 
 struct CallFunctionMessage
@@ -71,6 +95,8 @@ struct CallFunctionMessage
     uint32_t index;
     int argc;
     uintptr_t argv[64];
+    bool pure;  // no side effects, the result may come from this tick's CallCache
+    bool decode;
 };
 
 struct UseItemMessage
@@ -112,6 +138,125 @@ struct CheckSignatureMessage
     int32_t result;
 };
 
+struct FindMethodMessage
+{
+    MessageType type = MessageType::FIND_METHOD;
+    avm::ScriptObject *object;
+    bool method_name;
+    char name[0x100];
+    char signature[0x100];
+
+    int32_t result;
+};
+
+// Slot of the first method whose body matches, see BytecodePattern for the syntax
+struct FindMethodPatternMessage
+{
+    MessageType type = MessageType::FIND_METHOD_PATTERN;
+    avm::ScriptObject *object;
+    char pattern[0x300];
+
+    int32_t result;
+};
+
+// Either object or class_name, the layout is written as json after the message
+struct GetLayoutMessage
+{
+    MessageType type = MessageType::GET_LAYOUT;
+    avm::ScriptObject *object;
+    char class_name[0x100];
+
+    uint32_t size;  // of the json, 0 if the class was not found
+};
+
+// The instructions follow the message
+struct RegisterScriptMessage
+{
+    MessageType type = MessageType::REGISTER_SCRIPT;
+    uint32_t count;
+    uint64_t roots[read_script::ROOTS];
+
+    int32_t result;
+};
+
+struct UnregisterScriptMessage
+{
+    MessageType type = MessageType::UNREGISTER_SCRIPT;
+    int32_t id;
+
+    bool result;
+};
+
+struct CallCacheStatsMessage
+{
+    MessageType type = MessageType::CALL_CACHE_STATS;
+    bool reset;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncached;
+};
+
+// After the message: objects, values (object major, set only), then the names, each
+// null terminated. The values (atoms for get, 1/0 for set) come back after the message.
+struct BulkPropertyMessage
+{
+    MessageType type = MessageType::BULK_PROPERTY;
+    bool set;
+    uint32_t object_count;
+    uint32_t name_count;
+    uint32_t names_size;
+
+    bool result;
+};
+
+// SignatureEntry array then the null terminated signatures after the message,
+// one int32_t result per entry comes back after the message
+struct CheckSignaturesMessage
+{
+    MessageType type = MessageType::CHECK_SIGNATURES;
+    uint32_t count;
+    uint32_t signatures_size;
+
+    bool result;
+};
+
+// The null terminated class names follow the message, one closure address per name
+// (0 if not found) comes back after the message
+struct FinddefMessage
+{
+    MessageType type = MessageType::FINDDEF;
+    uint32_t count;
+    uint32_t names_size;
+
+    bool result;
+};
+
+struct SignatureEntry
+{
+    uint64_t object;
+    uint32_t index;
+    uint8_t method_name;
+    uint8_t reserved[3];
+};
+
+// TickArea::ReadEntry array after the message
+struct RegisterReadsMessage
+{
+    MessageType type = MessageType::REGISTER_READS;
+    uint32_t count;
+
+    int32_t result;
+};
+
+struct UnregisterReadsMessage
+{
+    MessageType type = MessageType::UNREGISTER_READS;
+    int32_t id;
+
+    bool result;
+};
+
 union Message
 {
     Message() { };
@@ -124,9 +269,41 @@ union Message
     KeyClickMessage key;
     MouseClickMessage click;
     CheckSignatureMessage sig;
+    FindMethodMessage find_method;
+    GetLayoutMessage layout;
+    RegisterScriptMessage register_script;
+    UnregisterScriptMessage unregister_script;
+    RegisterReadsMessage register_reads;
+    UnregisterReadsMessage unregister_reads;
+    CallCacheStatsMessage cache_stats;
+    BulkPropertyMessage bulk_property;
+    CheckSignaturesMessage check_signatures;
+    FinddefMessage finddef;
+    FindMethodPatternMessage find_method_pattern;
 };
 
-static_assert(sizeof(Message) < MEM_SIZE, "Message is larger than the allocated shared memory");
+static_assert(sizeof(Message) < MESSAGE_SIZE, "Message is larger than the allocated shared memory");
+
+static const char *sst_name(avm::SlotStorageType sst)
+{
+    static const char *names[] = { "atom", "string", "namespace", "object", "int", "uint", "bool", "double" };
+    return (sst < std::size(names)) ? names[sst] : "unknown";
+}
+
+static std::string layout_json(const avm::ClassLayout &layout)
+{
+    std::string json = "{\"name\":" + utils::escape_json(layout.name) + ",\"slots\":[";
+    for (size_t i = 0; i < layout.slots.size(); i++)
+    {
+        const auto &slot = layout.slots[i];
+        json += (i ? ",{\"name\":" : "{\"name\":") + utils::escape_json(std::string(slot.name));
+        json += ",\"offset\":" + std::to_string(slot.offset);
+        json += ",\"storage\":\"" + std::string(sst_name(slot.sst)) + "\"";
+        json += ",\"type\":" + utils::escape_json(slot.type) + "}";
+    }
+    json += "]}";
+    return json;
+}
 
 bool Ipc::Init()
 {
@@ -159,6 +336,20 @@ bool Ipc::Init()
     return true;
 }
 
+uint8_t *Ipc::TickMemory() const
+{
+    if (!m_shared || m_shared == reinterpret_cast<Message *>(-1))
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<uint8_t *>(m_shared) + TICK_OFFSET;
+}
+
+size_t Ipc::TickSize() const
+{
+    return TICK_SIZE;
+}
+
 void Ipc::Remove()
 {
     union semun dummy;
@@ -218,18 +409,59 @@ void Ipc::handle_message()
                 break;
             }
 
-            auto res = Darkorbit::get().call_sync([call] {
-                return call->object->call_method(call->index, call->argc, call->argv);
-            });
+            if (call->decode)
+            {
+                Darkorbit::CallValue decoded;
+                if (!Darkorbit::get().call_sync_value([msg = *call]
+                    {
+                        return Darkorbit::get().call_decoded(msg.object, msg.index, msg.argc, msg.argv);
+                    }, &decoded))
+                {
+                    result->error = true;
+                    result->type = MessageType::RESULT;
+                    break;
+                }
+
+                size_t string_size = utf::truncate(decoded.string, TICK_OFFSET - MESSAGE_SIZE);
+                std::memcpy(reinterpret_cast<char *>(m_shared) + MESSAGE_SIZE, decoded.string.data(), string_size);
+
+                result->type = MessageType::RESULT;
+                result->error = false;
+                result->value = decoded.value;
+                result->value_type = decoded.type;
+                result->string_size = static_cast<uint32_t>(string_size);
+                result->truncated = string_size < decoded.string.size();
+                break;
+            }
+
+            auto &cache = Darkorbit::get().call_cache();
+            uintptr_t object = reinterpret_cast<uintptr_t>(call->object);
 
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            uintptr_t value = 0;
+            if (call->pure && cache.find(object, call->index, call->argc, call->argv, value))
+            {
+                result->type = MessageType::RESULT;
+                result->error = false;
+                result->value = value;
+                break;
+            }
+
+            // Copy the request so a late (abandoned) call never reads a reused shared buffer
+            if (!Darkorbit::get().call_sync([msg = *call]
+                {
+                    uintptr_t r = msg.object->call_method(msg.index, msg.argc, msg.argv);
+                    if (msg.pure)
+                    {
+                        Darkorbit::get().call_cache().insert(reinterpret_cast<uintptr_t>(msg.object), msg.index, msg.argc, msg.argv, r);
+                    }
+                    return r;
+                }, &value))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
             }
             else
             {
-                auto value = res.get();
                 result->type = MessageType::RESULT;
                 result->error = false;
                 result->value = value;
@@ -239,7 +471,6 @@ void Ipc::handle_message()
         case MessageType::SEND_NOTIFICATION:
         {
             auto *msg = reinterpret_cast<SendNotificationMessage *>(m_shared);
-            std::string name(msg->name, strnlen(msg->name, sizeof(msg->name)));
 
             if (static_cast<size_t>(msg->argc) > sizeof(msg->argv) / sizeof(msg->argv[0]))
             {
@@ -249,15 +480,11 @@ void Ipc::handle_message()
                 break;
             }
 
-            std::vector<uintptr_t> args(&msg->argv[0], &msg->argv[msg->argc]);
-
-            // move args into the lambda to avoid an extra copy; Darkorbit::send_notification takes a const-ref
-            auto res = Darkorbit::get().call_sync([name, args = std::move(args)] ()
-            {
-                return Darkorbit::get().send_notification(name, args);
-            });
-
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            if (!Darkorbit::get().call_sync([msg = *msg] ()
+                {
+                    std::string_view name(msg.name, strnlen(msg.name, sizeof(msg.name)));
+                    return Darkorbit::get().send_notification(name, msg.argc, msg.argv);
+                }))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
@@ -267,14 +494,12 @@ void Ipc::handle_message()
         case MessageType::USE_ITEM:
         {
             auto *msg = reinterpret_cast<UseItemMessage *>(m_shared);
-            std::string name(msg->name, strnlen(msg->name, sizeof(msg->name)));
-
-            auto res = Darkorbit::get().call_sync([name] ()
-            {
-                return Darkorbit::get().use_item(name, 0, 1);
-            });
 
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            if (!Darkorbit::get().call_sync([msg = *msg] ()
+                {
+                    std::string_view name(msg.name, strnlen(msg.name, sizeof(msg.name)));
+                    return Darkorbit::get().use_item(name, 0, 1);
+                }))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
@@ -284,12 +509,10 @@ void Ipc::handle_message()
         case MessageType::REFINE:
         {
             auto *msg = reinterpret_cast<RefineMessage *>(m_shared);
-            auto res = Darkorbit::get().call_sync([ore=msg->ore, amount=msg->amount]
-            {
-                return Darkorbit::get().refine_ore(ore, amount);
-            });
-
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            if (!Darkorbit::get().call_sync([ore=msg->ore, amount=msg->amount]
+                {
+                    return Darkorbit::get().refine_ore(ore, amount);
+                }))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
@@ -300,12 +523,10 @@ void Ipc::handle_message()
         case MessageType::KEY_CLICK:
         {
             auto *msg = reinterpret_cast<KeyClickMessage *>(m_shared);
-            auto res = Darkorbit::get().call_sync([key=msg->key]
-            {
-                return Darkorbit::get().key_click(key);
-            });
-
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            if (!Darkorbit::get().call_sync([key=msg->key]
+                {
+                    return Darkorbit::get().key_click(key);
+                }))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
@@ -316,12 +537,10 @@ void Ipc::handle_message()
         case MessageType::MOUSE_CLICK:
         {
             auto *msg = reinterpret_cast<MouseClickMessage *>(m_shared);
-            auto res = Darkorbit::get().call_sync([msg]
-            {
-                return Darkorbit::get().mouse_click(msg->x, msg->y, msg->button);
-            });
-
-            if (res.wait_for(5000ms) != std::future_status::ready)
+            if (!Darkorbit::get().call_sync([x=msg->x, y=msg->y, button=msg->button]
+                {
+                    return Darkorbit::get().mouse_click(x, y, button);
+                }))
             {
                 result->error = true;
                 result->type = MessageType::RESULT;
@@ -331,28 +550,315 @@ void Ipc::handle_message()
         }
         case MessageType::CHECK_SIGNATURE:
         {
-            auto *sig_result = reinterpret_cast<CheckSignatureMessage *>(m_shared);
             auto *msg = reinterpret_cast<CheckSignatureMessage *>(m_shared);
-            std::string signature(msg->signature, strnlen(msg->signature, sizeof(msg->signature)));
 
-            auto res = Darkorbit::get().call_sync([msg, signature]()
+            uintptr_t value = 0;
+            if (Darkorbit::get().call_sync([msg = *msg]()
+                {
+                    std::string signature(msg.signature, strnlen(msg.signature, sizeof(msg.signature)));
+                    return Darkorbit::get().check_method_signature(msg.object, msg.index, msg.method_name, signature);
+                }, &value))
             {
-                return Darkorbit::get().check_method_signature(msg->object, msg->index, msg->method_name, signature);
-            });
-
+                msg->result = static_cast<int32_t>(value);
+            }
+            else
+            {
+                utils::log("[Ipc::handle_message] Signature check timed out");
+                msg->result = -1;
+            }
 
-            if (res.wait_for(5000ms) == std::future_status::ready)
+            break;
+        }
+        case MessageType::FIND_METHOD:
+        {
+            auto *msg = reinterpret_cast<FindMethodMessage *>(m_shared);
+
+            uintptr_t value = 0;
+            if (Darkorbit::get().call_sync([msg = *msg]()
+                {
+                    std::string name(msg.name, strnlen(msg.name, sizeof(msg.name)));
+                    std::string signature(msg.signature, strnlen(msg.signature, sizeof(msg.signature)));
+                    return Darkorbit::get().find_method(msg.object, name, msg.method_name, signature);
+                }, &value))
             {
-                sig_result->result = res.get();
+                msg->result = static_cast<int32_t>(value);
             }
             else
             {
-                utils::log("[Ipc::handle_message] Signature check timed out");
-                sig_result->result = -1;
+                utils::log("[Ipc::handle_message] Find method timed out");
+                msg->result = -1;
             }
 
             break;
         }
+        case MessageType::FIND_METHOD_PATTERN:
+        {
+            auto *msg = reinterpret_cast<FindMethodPatternMessage *>(m_shared);
+
+            // one slice of the search per call, so a first search does not stall a frame
+            std::string pattern(msg->pattern, strnlen(msg->pattern, sizeof(msg->pattern)));
+            msg->result = Darkorbit::PATTERN_PENDING;
+            while (msg->result == Darkorbit::PATTERN_PENDING)
+            {
+                uintptr_t value = 0;
+                if (!Darkorbit::get().call_sync([object = msg->object, pattern]()
+                    {
+                        return Darkorbit::get().find_method_by_pattern(object, pattern);
+                    }, &value))
+                {
+                    utils::log("[Ipc::handle_message] Find method by pattern timed out");
+                    msg->result = -1;
+                    break;
+                }
+                msg->result = static_cast<int32_t>(value);
+            }
+
+            break;
+        }
+        case MessageType::GET_LAYOUT:
+        {
+            auto *msg = reinterpret_cast<GetLayoutMessage *>(m_shared);
+            msg->size = 0;
+
+            avm::ClassLayoutRef layout;
+            if (!Darkorbit::get().call_sync_value([msg = *msg]()
+                {
+                    std::string class_name(msg.class_name, strnlen(msg.class_name, sizeof(msg.class_name)));
+                    return Darkorbit::get().get_layout(msg.object, class_name);
+                }, &layout))
+            {
+                utils::log("[Ipc::handle_message] Get layout timed out");
+                break;
+            }
+
+            if (!layout)
+            {
+                break;
+            }
+
+            std::string json = layout_json(*layout);
+
+            if (json.size() > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                utils::log("[Ipc::handle_message] Layout of {} does not fit, {} bytes\n", layout->name, json.size());
+                break;
+            }
+
+            std::memcpy(reinterpret_cast<char *>(m_shared) + MESSAGE_SIZE, json.data(), json.size());
+            msg->size = static_cast<uint32_t>(json.size());
+            break;
+        }
+        case MessageType::REGISTER_SCRIPT:
+        {
+            auto *msg = reinterpret_cast<RegisterScriptMessage *>(m_shared);
+
+            if (msg->count * sizeof(read_script::Instruction) > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                msg->result = -1;
+                break;
+            }
+
+            auto *code = reinterpret_cast<const read_script::Instruction *>(reinterpret_cast<uint8_t *>(m_shared) + MESSAGE_SIZE);
+            msg->result = Darkorbit::get().tick_area().register_script(code, msg->count, msg->roots);
+            break;
+        }
+        case MessageType::UNREGISTER_SCRIPT:
+        {
+            auto *msg = reinterpret_cast<UnregisterScriptMessage *>(m_shared);
+            msg->result = Darkorbit::get().tick_area().unregister_script(msg->id);
+            break;
+        }
+        case MessageType::REGISTER_READS:
+        {
+            auto *msg = reinterpret_cast<RegisterReadsMessage *>(m_shared);
+
+            if (msg->count * sizeof(TickArea::ReadEntry) > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                msg->result = -1;
+                break;
+            }
+
+            auto *entries = reinterpret_cast<const TickArea::ReadEntry *>(reinterpret_cast<uint8_t *>(m_shared) + MESSAGE_SIZE);
+            msg->result = Darkorbit::get().tick_area().register_reads(entries, msg->count);
+            break;
+        }
+        case MessageType::UNREGISTER_READS:
+        {
+            auto *msg = reinterpret_cast<UnregisterReadsMessage *>(m_shared);
+            msg->result = Darkorbit::get().tick_area().unregister_reads(msg->id);
+            break;
+        }
+        case MessageType::CALL_CACHE_STATS:
+        {
+            auto *msg = reinterpret_cast<CallCacheStatsMessage *>(m_shared);
+            auto stats = Darkorbit::get().call_cache().stats(msg->reset);
+
+            msg->hits = stats.hits;
+            msg->misses = stats.misses;
+            msg->uncached = stats.uncached;
+            break;
+        }
+        case MessageType::BULK_PROPERTY:
+        {
+            auto *msg = reinterpret_cast<BulkPropertyMessage *>(m_shared);
+            auto *payload = reinterpret_cast<uint8_t *>(m_shared) + MESSAGE_SIZE;
+
+            size_t value_count = static_cast<size_t>(msg->object_count) * msg->name_count;
+            size_t objects_size = msg->object_count * sizeof(uint64_t);
+            size_t values_size = value_count * sizeof(uint64_t);
+            msg->result = false;
+
+            if (objects_size + (msg->set ? values_size : 0) + msg->names_size > TICK_OFFSET - MESSAGE_SIZE
+                    || values_size > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                break;
+            }
+
+            // The request is copied out of the shared memory, the flash thread works on the copy
+            struct Request
+            {
+                bool set;
+                std::vector<uintptr_t> objects;
+                std::vector<std::string> names;
+                std::vector<uint64_t> values;
+            };
+
+            // shared with the call, whichever of both finishes last frees it
+            auto request = std::make_shared<Request>();
+            request->set = msg->set;
+            auto *objects = reinterpret_cast<const uint64_t *>(payload);
+            request->objects.assign(objects, objects + msg->object_count);
+            request->values.resize(value_count);
+
+            const char *names = reinterpret_cast<const char *>(payload + objects_size + (msg->set ? values_size : 0));
+            for (size_t pos = 0; pos < msg->names_size && request->names.size() < msg->name_count; )
+            {
+                size_t len = strnlen(names + pos, msg->names_size - pos);
+                request->names.emplace_back(names + pos, len);
+                pos += len + 1;
+            }
+
+            if (request->names.size() != msg->name_count)
+            {
+                break;
+            }
+
+            if (msg->set)
+            {
+                std::memcpy(request->values.data(), payload + objects_size, values_size);
+            }
+
+            uintptr_t value = 0;
+            if (!Darkorbit::get().call_sync([request]
+                {
+                    return Darkorbit::get().bulk_property(request->set, request->objects.data(), request->objects.size(),
+                                                          request->names, request->values.data());
+                }, &value))
+            {
+                utils::log("[Ipc::handle_message] Bulk property timed out");
+                break;
+            }
+
+            std::memcpy(payload, request->values.data(), values_size);
+            msg->result = value != 0;
+            break;
+        }
+        case MessageType::CHECK_SIGNATURES:
+        {
+            auto *msg = reinterpret_cast<CheckSignaturesMessage *>(m_shared);
+            auto *payload = reinterpret_cast<uint8_t *>(m_shared) + MESSAGE_SIZE;
+
+            size_t entries_size = static_cast<size_t>(msg->count) * sizeof(SignatureEntry);
+            msg->result = false;
+
+            if (msg->count == 0 || entries_size + msg->signatures_size > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                break;
+            }
+
+            // Expected signatures are hashed here, the flash thread only compares them
+            struct Request
+            {
+                std::vector<Darkorbit::SignatureCheck> checks;
+                std::vector<int32_t> results;
+            };
+
+            auto request = std::make_shared<Request>();
+            request->checks.reserve(msg->count);
+            request->results.resize(msg->count, -1);
+
+            auto *entries = reinterpret_cast<const SignatureEntry *>(payload);
+            const char *signatures = reinterpret_cast<const char *>(payload + entries_size);
+            for (size_t i = 0, pos = 0; i < msg->count && pos < msg->signatures_size; i++)
+            {
+                size_t len = strnlen(signatures + pos, msg->signatures_size - pos);
+                request->checks.push_back({ reinterpret_cast<avm::ScriptObject *>(entries[i].object), entries[i].index,
+                                            entries[i].method_name != 0, utils::fnv1a({ signatures + pos, len }) });
+                pos += len + 1;
+            }
+
+            if (request->checks.size() != msg->count)
+            {
+                break;
+            }
+
+            uintptr_t value = 0;
+            if (!Darkorbit::get().call_sync([request]
+                {
+                    Darkorbit::get().check_method_signatures(request->checks.data(), request->checks.size(),
+                                                             request->results.data());
+                    return true;
+                }, &value))
+            {
+                utils::log("[Ipc::handle_message] Signature checks timed out");
+                break;
+            }
+
+            std::memcpy(payload, request->results.data(), request->results.size() * sizeof(int32_t));
+            msg->result = true;
+            break;
+        }
+        case MessageType::FINDDEF:
+        {
+            auto *msg = reinterpret_cast<FinddefMessage *>(m_shared);
+            auto *payload = reinterpret_cast<uint8_t *>(m_shared) + MESSAGE_SIZE;
+            msg->result = false;
+
+            if (msg->count == 0 || msg->names_size > TICK_OFFSET - MESSAGE_SIZE
+                    || msg->count * sizeof(uint64_t) > TICK_OFFSET - MESSAGE_SIZE)
+            {
+                break;
+            }
+
+            std::vector<std::string> names;
+            const char *data = reinterpret_cast<const char *>(payload);
+            for (size_t pos = 0; pos < msg->names_size && names.size() < msg->count; )
+            {
+                size_t len = strnlen(data + pos, msg->names_size - pos);
+                names.emplace_back(data + pos, len);
+                pos += len + 1;
+            }
+
+            if (names.size() != msg->count)
+            {
+                break;
+            }
+
+            std::vector<avm::ClassClosure *> closures;
+            if (!Darkorbit::get().call_sync_value([names] { return Darkorbit::get().finddef(names); }, &closures))
+            {
+                utils::log("[Ipc::handle_message] Finddef timed out");
+                break;
+            }
+
+            for (size_t i = 0; i < closures.size(); i++)
+            {
+                uint64_t address = reinterpret_cast<uintptr_t>(closures[i]);
+                std::memcpy(payload + i * sizeof(uint64_t), &address, sizeof(address));
+            }
+            msg->result = true;
+            break;
+        }
         default:
             utils::log("[Ipc::handle_message] Unknown ipc message type {x}\n", static_cast<int>(m_shared->type));
             break;
@@ -1,6 +1,8 @@
 #ifndef IPC_H
 #define IPC_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <thread>
 
@@ -24,6 +26,10 @@ public:
 
     void Remove();
 
+    // Area after the messages that TickArea publishes its frames in
+    uint8_t *TickMemory() const;
+    size_t TickSize() const;
+
     ~Ipc();
 private:
     void handle_message();
@@ -43,6 +43,11 @@ namespace memory
 
     std::vector<MemPage> get_pages(const std::string &name = "");
 
+    // memcpy that returns false instead of crashing if src is not readable. Faults are
+    // caught by a SIGSEGV/SIGBUS handler installed on first use, other faults go on to
+    // the handler that was installed before.
+    bool safe_copy(void *dst, uintptr_t src, size_t size);
+
     template<typename T>
     inline T read(uintptr_t addr)
     {
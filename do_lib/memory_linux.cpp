@@ -1,6 +1,10 @@
 #include "memory.h"
 #include <cstring>
 #include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <csetjmp>
+#include <csignal>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <time.h>
@@ -49,6 +53,73 @@ std::vector<memory::MemPage> memory::get_pages(const std::string &name)
     return pages;
 }
 
+// Read from the signal handler: initial-exec keeps the access a plain fs relative load,
+// the dynamic model of a dlopen'ed lib may call __tls_get_addr which is not signal safe
+static thread_local sigjmp_buf *t_fault_jump __attribute__((tls_model("initial-exec"))) = nullptr;
+static struct sigaction g_prev_segv, g_prev_bus;
+
+static void fault_handler(int sig, siginfo_t *info, void *context)
+{
+    if (sigjmp_buf *jump = t_fault_jump)
+    {
+        t_fault_jump = nullptr;
+        siglongjmp(*jump, 1);
+    }
+
+    // not ours, pass it on
+    struct sigaction *prev = (sig == SIGBUS) ? &g_prev_bus : &g_prev_segv;
+    if ((prev->sa_flags & SA_SIGINFO) && prev->sa_sigaction)
+    {
+        prev->sa_sigaction(sig, info, context);
+        return;
+    }
+    if (!(prev->sa_flags & SA_SIGINFO) && prev->sa_handler != SIG_DFL && prev->sa_handler != SIG_IGN)
+    {
+        prev->sa_handler(sig);
+        return;
+    }
+
+    // default action, the faulting instruction runs again and takes it
+    sigaction(sig, prev, nullptr);
+}
+
+static void install_fault_handler()
+{
+    struct sigaction sa { };
+    sa.sa_sigaction = fault_handler;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+
+    sigaction(SIGSEGV, &sa, &g_prev_segv);
+    sigaction(SIGBUS, &sa, &g_prev_bus);
+}
+
+bool memory::safe_copy(void *dst, uintptr_t src, size_t size)
+{
+    static std::once_flag installed;
+    std::call_once(installed, install_fault_handler);
+
+    if (src < 0x10000 || src + size < src)
+    {
+        return false;
+    }
+
+    // no signal mask save: SA_NODEFER leaves SIGSEGV unblocked after the jump
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 0))
+    {
+        return false;
+    }
+
+    t_fault_jump = &jump;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    std::memcpy(dst, reinterpret_cast<const void *>(src), size);
+
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    t_fault_jump = nullptr;
+    return true;
+}
 
 uintptr_t memory::query_memory(uint8_t *query, const char *mask, uint32_t alignment, const std::string &area)
 {
@@ -0,0 +1,85 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Cache keyed by pointers into the GC heap. Entries are bucketed by the GC block (page)
+// that holds the key, so a freed chunk only evicts the entries that lived inside it.
+// Not synchronized, callers hold their own lock.
+template<typename K, typename V>
+class PageCache
+{
+public:
+    static constexpr uintptr_t PAGE_SIZE = 0x1000;
+
+    const V *find(const K *key) const
+    {
+        auto it = m_pages.find(page_of(key));
+        if (it == m_pages.end())
+        {
+            return nullptr;
+        }
+
+        for (auto &entry : it->second)
+        {
+            if (entry.first == key)
+            {
+                return &entry.second;
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns the cached value if the key is already present
+    const V &insert(const K *key, V value)
+    {
+        auto &bucket = m_pages[page_of(key)];
+        for (auto &entry : bucket)
+        {
+            if (entry.first == key)
+            {
+                return entry.second;
+            }
+        }
+        bucket.emplace_back(key, std::move(value));
+        return bucket.back().second;
+    }
+
+    size_t evict(uintptr_t chunk, size_t size = PAGE_SIZE)
+    {
+        if (m_pages.empty())
+        {
+            return 0;
+        }
+
+        size_t evicted = 0;
+        for (uintptr_t page = chunk & ~(PAGE_SIZE - 1); page < chunk + size; page += PAGE_SIZE)
+        {
+            auto it = m_pages.find(page);
+            if (it != m_pages.end())
+            {
+                evicted += it->second.size();
+                m_pages.erase(it);
+            }
+        }
+        return evicted;
+    }
+
+    void clear()
+    {
+        m_pages.clear();
+    }
+
+private:
+    static inline uintptr_t page_of(const K *key)
+    {
+        return reinterpret_cast<uintptr_t>(key) & ~(PAGE_SIZE - 1);
+    }
+
+    std::unordered_map<uintptr_t, std::vector<std::pair<const K *, V>>> m_pages;
+};
+
+#endif /* PAGE_CACHE_H */
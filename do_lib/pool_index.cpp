@@ -0,0 +1,460 @@
+#include "pool_index.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "disassembler.h"
+#include "utils.h"
+
+static std::atomic<PoolIndex *> g_pools[PoolIndex::MAX_POOLS];
+static std::mutex g_pools_mutex;
+
+// Dropped indices wait for collect(), a caller on the flash thread may still hold one
+static std::vector<std::unique_ptr<PoolIndex>> g_retired;
+
+PoolIndex *PoolIndex::find(const avm::PoolObject *pool)
+{
+    for (auto &slot : g_pools)
+    {
+        PoolIndex *index = slot.load(std::memory_order_acquire);
+        if (index && index->m_pool == pool)
+        {
+            return index;
+        }
+    }
+    return nullptr;
+}
+
+PoolIndex *PoolIndex::request(avm::PoolObject *pool, bool full)
+{
+    if (!pool)
+    {
+        return nullptr;
+    }
+
+    auto *index = find(pool);
+    if (index && (index->m_full || !full))
+    {
+        return index;
+    }
+
+    std::lock_guard<std::mutex> lock(g_pools_mutex);
+
+    std::atomic<PoolIndex *> *free_slot = nullptr;
+    size_t free_count = 0;
+    for (auto &slot : g_pools)
+    {
+        index = slot.load(std::memory_order_relaxed);
+        if (index && index->m_pool == pool)
+        {
+            if (full && !index->m_full)
+            {
+                // names only so far, the build continues after the names
+                index->m_full = true;
+                if (index->m_phase == Phase::Done)
+                {
+                    index->m_phase = Phase::Multinames;
+                }
+            }
+            return index;
+        }
+        if (!index)
+        {
+            free_slot = free_slot ? free_slot : &slot;
+            free_count++;
+        }
+    }
+
+    if (!free_slot || (!full && free_count <= RESERVED_FULL))
+    {
+        return nullptr;
+    }
+
+    index = new PoolIndex(pool);
+    index->m_full = full;
+    free_slot->store(index, std::memory_order_release);
+    return index;
+}
+
+void PoolIndex::step(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(g_pools_mutex);
+    for (bool full : { true, false })
+    {
+        for (auto &slot : g_pools)
+        {
+            PoolIndex *index = slot.load(std::memory_order_relaxed);
+            if (!budget)
+            {
+                return;
+            }
+            if (index && index->m_full == full && index->m_phase != Phase::Done)
+            {
+                budget -= std::min(budget, index->build(budget));
+            }
+        }
+    }
+}
+
+void PoolIndex::collect()
+{
+    std::lock_guard<std::mutex> lock(g_pools_mutex);
+    g_retired.clear();
+}
+
+void PoolIndex::evict(uintptr_t chunk)
+{
+    for (auto &slot : g_pools)
+    {
+        PoolIndex *index = slot.load(std::memory_order_acquire);
+        if (index && (reinterpret_cast<uintptr_t>(index->m_pool) & ~0xfffULL) == chunk)
+        {
+            std::lock_guard<std::mutex> lock(g_pools_mutex);
+            if (slot.compare_exchange_strong(index, nullptr))
+            {
+                g_retired.emplace_back(index);
+            }
+        }
+    }
+}
+
+void PoolIndex::clear()
+{
+    std::lock_guard<std::mutex> lock(g_pools_mutex);
+    for (auto &slot : g_pools)
+    {
+        if (PoolIndex *index = slot.exchange(nullptr))
+        {
+            g_retired.emplace_back(index);
+        }
+    }
+}
+
+size_t PoolIndex::build(size_t budget)
+{
+    size_t used = 0;
+    while (used < budget && m_phase != Phase::Done)
+    {
+        switch (m_phase)
+        {
+            case Phase::Kinds:
+                used += build_kinds(budget - used);
+                break;
+            case Phase::Names:
+                used += build_names(budget - used);
+                break;
+            case Phase::Multinames:
+                used += build_multinames(budget - used);
+                if (m_multinames_ready)
+                {
+                    m_phase = Phase::Xrefs;
+                }
+                break;
+            case Phase::Xrefs:
+                used += build_xrefs(budget - used);
+                break;
+            case Phase::Invert:
+                used += build_invert(budget - used);
+                break;
+            default:
+                break;
+        }
+    }
+    return used;
+}
+
+bool PoolIndex::usable(const avm::MethodInfo *method, size_t id) const
+{
+    return method && method->pool == m_pool && static_cast<size_t>(method->id) == id;
+}
+
+uint64_t PoolIndex::abc_hash()
+{
+    std::call_once(m_abc_hash_once, [this] { m_abc_hash = hash_abc(m_pool); });
+    return m_abc_hash;
+}
+
+uint64_t PoolIndex::hash_abc(avm::PoolObject *pool)
+{
+    const uint8_t *start = pool->abc_strings_start;
+    const uint8_t *end = pool->abc_strings_end;
+
+    if (!start || end <= start || static_cast<size_t>(end - start) > 0x10000000)
+    {
+        return 0;
+    }
+
+    utils::Fnv1a h;
+    h.add(start, end - start);
+
+    uint64_t count = pool->method_count();
+    h.add(&count, sizeof(count));
+    return h.value;
+}
+
+avm::Multiname *PoolIndex::find_multiname(std::string_view name)
+{
+    build_multinames(SIZE_MAX);
+
+    auto it = m_mn_first.find(utils::fnv1a(name));
+    if (it == m_mn_first.end())
+    {
+        return nullptr;
+    }
+
+    for (uint32_t id = it->second; id != UINT32_MAX; id = m_mn_next[id])
+    {
+        avm::Multiname *mn = m_pool->get_multiname(id);
+        if (mn && mn->name_equals(name))
+        {
+            return mn;
+        }
+    }
+    return nullptr;
+}
+
+size_t PoolIndex::build_kinds(size_t budget)
+{
+    if (m_cursor == 0)
+    {
+        m_names.assign(m_pool->method_count(), MethodName { });
+    }
+
+    size_t count = m_names.size();
+    size_t last = std::min(count, m_cursor + budget);
+    size_t used = last - m_cursor;
+
+    for (; m_cursor < last; m_cursor++)
+    {
+        avm::MethodInfo *method = m_pool->get_method(m_cursor);
+        if (!usable(method, m_cursor) || !method->declarer.is_traits())
+        {
+            continue;
+        }
+
+        // Every method declared by this traits gets its kind in one pass over its abc data
+        auto *traits = method->declarer.traits();
+        if (traits && m_visited.insert(traits).second)
+        {
+            traits->for_each_method_trait([this] (avm::TraitKind kind, uint32_t method_index)
+            {
+                if (method_index < m_names.size())
+                {
+                    m_names[method_index].kind = kind;
+                }
+                return false;
+            });
+        }
+    }
+
+    if (m_cursor == count)
+    {
+        m_visited = { };
+        m_cursor = 0;
+        m_phase = Phase::Names;
+    }
+    return std::max<size_t>(used, 1);
+}
+
+size_t PoolIndex::build_names(size_t budget)
+{
+    size_t count = m_names.size();
+    size_t last = std::min(count, m_cursor + budget);
+    size_t used = last - m_cursor;
+
+    for (; m_cursor < last; m_cursor++)
+    {
+        if (!usable(m_pool->get_method(m_cursor), m_cursor))
+        {
+            continue;
+        }
+
+        std::string name = m_pool->get_method_name(m_cursor);
+        if (name.empty())
+        {
+            continue;
+        }
+
+        switch (m_names[m_cursor].kind)
+        {
+            case avm::TRAIT_Setter:
+                name = "set " + name;
+                break;
+            case avm::TRAIT_Getter:
+                name = "get " + name;
+                break;
+            default:
+                break;
+        }
+        m_names[m_cursor].name = avm::intern(name);
+    }
+
+    if (m_cursor == count)
+    {
+        m_cursor = 0;
+        m_phase = m_full ? Phase::Multinames : Phase::Done;
+        m_names_ready.store(true, std::memory_order_release);
+
+        utils::log("[+] Indexed {} method names of pool {x}\n", count, reinterpret_cast<uintptr_t>(m_pool));
+    }
+    return std::max<size_t>(used, 1);
+}
+
+size_t PoolIndex::build_multinames(size_t budget)
+{
+    if (m_multinames_ready)
+    {
+        return 0;
+    }
+
+    size_t count = m_pool->precomp_mn_size;
+    if (m_mn_cursor == 0)
+    {
+        m_mn_next.assign(count, UINT32_MAX);
+        m_mn_first.reserve(count);
+        m_mn_tails.reserve(count);
+    }
+
+    size_t last = std::min(count, m_mn_cursor + std::min(budget, count));
+    size_t used = last - m_mn_cursor;
+
+    for (; m_mn_cursor < last; m_mn_cursor++)
+    {
+        uint32_t id = static_cast<uint32_t>(m_mn_cursor);
+        avm::Multiname *mn = m_pool->get_multiname(id);
+        if (!mn || (mn->flags & 8) || !mn->name) // RTNAME
+        {
+            continue;
+        }
+
+        // tail of each chain, so appending keeps ids ascending like the old linear scan
+        uint64_t hash = mn->name->hash();
+        auto [tail, inserted] = m_mn_tails.emplace(hash, id);
+        if (inserted)
+        {
+            m_mn_first.emplace(hash, id);
+        }
+        else
+        {
+            m_mn_next[tail->second] = id;
+            tail->second = id;
+        }
+    }
+
+    if (m_mn_cursor == count)
+    {
+        m_mn_tails = { };
+        m_multinames_ready = true;
+
+        utils::log("[+] Indexed {} multinames of pool {x}\n", count, reinterpret_cast<uintptr_t>(m_pool));
+    }
+    return std::max<size_t>(used, 1);
+}
+
+size_t PoolIndex::build_xrefs(size_t budget)
+{
+    // decoding a body costs more than a name lookup
+    constexpr size_t METHOD_COST = 4;
+
+    size_t method_count = m_names.size();
+    size_t mn_count = m_pool->precomp_mn_size;
+
+    if (m_cursor == 0)
+    {
+        m_method_offsets.assign(method_count + 1, 0);
+        m_mn_offsets.assign(mn_count + 1, 0);
+
+        // last method that referenced a multiname, drops repeated references of one method
+        m_last_ref.assign(mn_count, UINT32_MAX);
+    }
+
+    size_t last = std::min(method_count, m_cursor + std::max<size_t>(budget / METHOD_COST, 1));
+    size_t used = (last - m_cursor) * METHOD_COST;
+
+    for (; m_cursor < last; m_cursor++)
+    {
+        size_t id = m_cursor;
+        m_method_offsets[id] = static_cast<uint32_t>(m_method_xrefs.size());
+
+        avm::MethodInfo *method = m_pool->get_method(id);
+        if (!usable(method, id) || !method->abc_code)
+        {
+            continue;
+        }
+
+        size_t row_start = m_method_xrefs.size();
+        bool ok = Disassembler::Visit(method->abc_code, [&] (const AbcInstruction &inst)
+        {
+            uint32_t xref;
+            if (Disassembler::GetXref(inst, &xref) && xref < mn_count && m_last_ref[xref] != id)
+            {
+                m_last_ref[xref] = static_cast<uint32_t>(id);
+                m_method_xrefs.push_back(xref);
+            }
+            return false;
+        });
+
+        if (!ok)
+        {
+            // keep the table consistent with what a full decode would give: nothing
+            for (size_t i = row_start; i < m_method_xrefs.size(); i++)
+            {
+                m_last_ref[m_method_xrefs[i]] = UINT32_MAX;
+            }
+            m_method_xrefs.resize(row_start);
+            m_failed++;
+            continue;
+        }
+
+        for (size_t i = row_start; i < m_method_xrefs.size(); i++)
+        {
+            m_mn_offsets[m_method_xrefs[i] + 1]++;
+        }
+    }
+
+    if (m_cursor == method_count)
+    {
+        m_method_offsets[method_count] = static_cast<uint32_t>(m_method_xrefs.size());
+        m_last_ref = { };
+
+        // prefix sums of the counts give each multiname its row, filled by build_invert
+        for (size_t i = 0; i < mn_count; i++)
+        {
+            m_mn_offsets[i + 1] += m_mn_offsets[i];
+        }
+        m_mn_fill.assign(m_mn_offsets.begin(), m_mn_offsets.end() - 1);
+        m_mn_xrefs.resize(m_method_xrefs.size());
+
+        m_cursor = 0;
+        m_phase = Phase::Invert;
+    }
+    return std::max<size_t>(used, 1);
+}
+
+size_t PoolIndex::build_invert(size_t budget)
+{
+    size_t method_count = m_names.size();
+    size_t used = 0;
+
+    // methods are visited in id order, so every multiname row comes out ascending
+    for (; m_cursor < method_count && used < budget; m_cursor++)
+    {
+        uint32_t id = static_cast<uint32_t>(m_cursor);
+        for (uint32_t i = m_method_offsets[id]; i < m_method_offsets[id + 1]; i++)
+        {
+            m_mn_xrefs[m_mn_fill[m_method_xrefs[i]]++] = id;
+        }
+        used += 1 + m_method_offsets[id + 1] - m_method_offsets[id];
+    }
+
+    if (m_cursor == method_count)
+    {
+        m_mn_fill = { };
+        m_phase = Phase::Done;
+        m_xrefs_ready.store(true, std::memory_order_release);
+
+        utils::log("[+] Indexed {} xrefs of pool {x} ({} methods failed to decode)\n",
+                   m_method_xrefs.size(), reinterpret_cast<uintptr_t>(m_pool), m_failed);
+    }
+    return std::max<size_t>(used, 1);
+}
@@ -0,0 +1,176 @@
+#ifndef POOL_INDEX_H
+#define POOL_INDEX_H
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "avm.h"
+
+// Lookup tables for a whole PoolObject, decoded a slice per tick on the flash thread so the
+// pool's memory can not be freed by the GC while it is read. Readers never lock: a table is
+// immutable once its ready flag is set.
+class PoolIndex
+{
+public:
+    struct MethodName
+    {
+        std::string_view name;                      // interned, same format as MethodInfo::name()
+        avm::TraitKind kind = avm::TRAIT_Method;
+    };
+
+    // View into one row of a compressed table
+    struct IdRange
+    {
+        const uint32_t *first = nullptr;
+        const uint32_t *last = nullptr;
+
+        inline const uint32_t *begin() const { return first; }
+        inline const uint32_t *end() const { return last; }
+        inline size_t size() const { return last - first; }
+        inline bool empty() const { return first == last; }
+    };
+
+    static constexpr size_t MAX_POOLS = 16;
+
+    // Slots only a full index may take, so the pools of other swfs can not crowd out the game's
+    static constexpr size_t RESERVED_FULL = 2;
+
+    // Methods or multinames decoded per step() from the timer tick
+    static constexpr size_t TICK_BUDGET = 4096;
+
+    // Index of a pool or nullptr if it was never requested
+    static PoolIndex *find(const avm::PoolObject *pool);
+
+    // Index of a pool, registers it on first use. Its tables are filled by step(), without
+    // full only the method names are. A later full request extends a names only index.
+    // nullptr if no slot is left.
+    static PoolIndex *request(avm::PoolObject *pool, bool full = true);
+
+    // Flash thread: continues building the registered indices for about budget methods,
+    // full indices first
+    static void step(size_t budget);
+
+    // Flash thread: frees the indices dropped by evict() and clear(). Only safe where no
+    // caller can still hold one, like the end of a tick.
+    static void collect();
+
+    // Forget the indices of pools inside a freed chunk / of every pool
+    static void evict(uintptr_t chunk);
+    static void clear();
+
+    inline bool names_ready() const
+    {
+        return m_names_ready.load(std::memory_order_acquire);
+    }
+
+    inline const MethodName *method_name(int32_t id) const
+    {
+        if (!names_ready() || id < 0 || static_cast<size_t>(id) >= m_names.size() || m_names[id].name.empty())
+        {
+            return nullptr;
+        }
+        return &m_names[id];
+    }
+
+    // Number of method ids in the pool, valid once names_ready()
+    inline size_t method_count() const
+    {
+        return m_names.size();
+    }
+
+    inline bool xrefs_ready() const
+    {
+        return m_xrefs_ready.load(std::memory_order_acquire);
+    }
+
+    // Multinames referenced by a method in code order, empty until xrefs_ready()
+    inline IdRange method_xrefs(int32_t id) const
+    {
+        return row(m_method_offsets, m_method_xrefs, id);
+    }
+
+    // Methods referencing a multiname in ascending id order, empty until xrefs_ready()
+    inline IdRange multiname_xrefs(uint32_t id) const
+    {
+        return row(m_mn_offsets, m_mn_xrefs, id);
+    }
+
+    // Fingerprint of the pool's abc strings and method count, computed once.
+    // Equal for pools loaded from the same swf, 0 if the pool has no string data.
+    uint64_t abc_hash();
+    static uint64_t hash_abc(avm::PoolObject *pool);
+
+    // First multiname with this name, finishes the hash table if step() has not yet
+    avm::Multiname *find_multiname(std::string_view name);
+
+    inline avm::PoolObject *pool() const
+    {
+        return m_pool;
+    }
+
+private:
+    enum class Phase : uint8_t
+    {
+        Kinds,
+        Names,
+        Multinames,
+        Xrefs,
+        Invert,
+        Done
+    };
+
+    explicit PoolIndex(avm::PoolObject *pool) : m_pool(pool) { }
+
+    // Each build function continues where the last call stopped and returns the work done
+    size_t build(size_t budget);
+    size_t build_kinds(size_t budget);
+    size_t build_names(size_t budget);
+    size_t build_multinames(size_t budget);
+    size_t build_xrefs(size_t budget);
+    size_t build_invert(size_t budget);
+
+    inline IdRange row(const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &values, int64_t id) const
+    {
+        if (!xrefs_ready() || id < 0 || static_cast<size_t>(id) + 1 >= offsets.size())
+        {
+            return { };
+        }
+        return { values.data() + offsets[id], values.data() + offsets[id + 1] };
+    }
+
+    bool usable(const avm::MethodInfo *method, size_t id) const;
+
+    avm::PoolObject *m_pool;
+    bool m_full = false;
+
+    // build state, only touched by the flash thread
+    Phase m_phase = Phase::Kinds;
+    size_t m_cursor = 0;
+    std::unordered_set<const avm::Traits *> m_visited;
+
+    std::atomic<bool> m_names_ready { false };
+    std::vector<MethodName> m_names;
+
+    // name hash -> lowest multiname id, ids sharing a hash are chained in ascending order
+    bool m_multinames_ready = false;
+    size_t m_mn_cursor = 0;
+    std::unordered_map<uint64_t, uint32_t> m_mn_first;
+    std::unordered_map<uint64_t, uint32_t> m_mn_tails;
+    std::vector<uint32_t> m_mn_next;
+
+    std::once_flag m_abc_hash_once;
+    uint64_t m_abc_hash = 0;
+
+    // Xrefs of both directions in CSR form: row i spans values[offsets[i]..offsets[i+1])
+    std::atomic<bool> m_xrefs_ready { false };
+    std::vector<uint32_t> m_method_offsets, m_method_xrefs;
+    std::vector<uint32_t> m_mn_offsets, m_mn_xrefs;
+    std::vector<uint32_t> m_last_ref, m_mn_fill;
+    size_t m_failed = 0;
+};
+
+#endif /* POOL_INDEX_H */
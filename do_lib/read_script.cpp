@@ -0,0 +1,275 @@
+#include "read_script.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "avm.h"
+#include "memory.h"
+
+using namespace read_script;
+
+static inline bool is_skip(Op op)
+{
+    return op == Op::SKIP_EQ || op == Op::SKIP_NE || op == Op::SKIP_LT || op == Op::SKIP_GE;
+}
+
+bool Script::load(const Instruction *code, size_t count, const uint64_t *roots, std::string &error)
+{
+    if (count == 0 || count > MAX_INSTRUCTIONS)
+    {
+        error = "bad instruction count " + std::to_string(count);
+        return false;
+    }
+
+    std::vector<size_t> loops;
+    for (size_t pc = 0; pc < count; pc++)
+    {
+        const Instruction &inst = code[pc];
+        std::string at = " at " + std::to_string(pc);
+
+        if (inst.op >= Op::COUNT)
+        {
+            error = "unknown op" + at;
+            return false;
+        }
+        if (inst.a >= REGISTERS || inst.b >= REGISTERS)
+        {
+            error = "bad register" + at;
+            return false;
+        }
+
+        switch (inst.op)
+        {
+            case Op::READ:
+                if (inst.c != 1 && inst.c != 2 && inst.c != 4 && inst.c != 8)
+                {
+                    error = "bad read size" + at;
+                    return false;
+                }
+                break;
+            case Op::EMIT:
+                if (inst.c == 0)
+                {
+                    error = "empty emit" + at;
+                    return false;
+                }
+                break;
+            case Op::FOR_EACH:
+                if (inst.c > 1 || inst.imm <= static_cast<int32_t>(pc) || static_cast<size_t>(inst.imm) >= count
+                        || code[inst.imm].op != Op::NEXT || loops.size() == MAX_DEPTH)
+                {
+                    error = "bad loop" + at;
+                    return false;
+                }
+                loops.push_back(inst.imm);
+                break;
+            case Op::NEXT:
+                if (loops.empty() || loops.back() != pc)
+                {
+                    error = "unmatched next" + at;
+                    return false;
+                }
+                loops.pop_back();
+                break;
+            default:
+                break;
+        }
+
+        if (is_skip(inst.op))
+        {
+            // may land on a NEXT but not jump into or out of a loop
+            if (pc + inst.c >= count)
+            {
+                error = "skip past the end" + at;
+                return false;
+            }
+            for (size_t i = pc + 1; i <= pc + inst.c; i++)
+            {
+                if (code[i].op == Op::FOR_EACH || code[i].op == Op::NEXT)
+                {
+                    error = "skip over a loop boundary" + at;
+                    return false;
+                }
+            }
+        }
+    }
+
+    if (!loops.empty())
+    {
+        error = "unterminated loop";
+        return false;
+    }
+
+    m_code.assign(code, code + count);
+    std::copy(roots, roots + ROOTS, m_roots);
+    return true;
+}
+
+size_t Script::run(uint8_t *out, size_t max, uint32_t &flags, size_t &budget) const
+{
+    struct Loop
+    {
+        size_t body, next;      // first instruction of the body, index of the NEXT
+        uintptr_t elements;
+        uint32_t index, size;
+        uint8_t reg;
+        size_t mark;            // output size when the current element started
+    };
+
+    uint64_t r[REGISTERS] = { };
+    std::copy(m_roots, m_roots + ROOTS, r);
+
+    Loop loops[MAX_DEPTH];
+    size_t depth = 0;
+    size_t pos = 0;
+    size_t pc = 0;
+    flags = 0;
+
+    for (size_t steps = 0; pc < m_code.size(); steps++, budget--)
+    {
+        if (steps == MAX_STEPS || budget == 0)
+        {
+            flags |= TRUNCATED;
+            break;
+        }
+
+        const Instruction &inst = m_code[pc];
+        bool ok = true;
+
+        switch (inst.op)
+        {
+            case Op::END:
+                return pos;
+            case Op::MOV:
+                r[inst.a] = r[inst.b];
+                break;
+            case Op::SET:
+                r[inst.a] = static_cast<uint64_t>(static_cast<int64_t>(inst.imm));
+                break;
+            case Op::ADD:
+                r[inst.a] += static_cast<uint64_t>(static_cast<int64_t>(inst.imm));
+                break;
+            case Op::AND:
+                r[inst.a] &= static_cast<uint64_t>(static_cast<int64_t>(inst.imm));
+                break;
+            case Op::READ:
+            {
+                uint64_t value = 0;
+                ok = memory::safe_copy(&value, r[inst.b] + inst.imm, inst.c);
+                r[inst.a] = value;
+                break;
+            }
+            case Op::EMIT:
+                if (pos + inst.c > max)
+                {
+                    flags |= TRUNCATED;
+                    return pos;
+                }
+                if ((ok = memory::safe_copy(out + pos, r[inst.a] + inst.imm, inst.c)))
+                {
+                    pos += inst.c;
+                }
+                break;
+            case Op::EMIT_REG:
+                if (pos + sizeof(uint64_t) > max)
+                {
+                    flags |= TRUNCATED;
+                    return pos;
+                }
+                std::memcpy(out + pos, &r[inst.a], sizeof(uint64_t));
+                pos += sizeof(uint64_t);
+                break;
+            case Op::FOR_EACH:
+            {
+                const auto &layout = inst.c ? avm::VECTOR_LAYOUT : avm::ARRAY_LAYOUT;
+                uintptr_t collection = r[inst.b] & ~7ULL;
+                uintptr_t buffer = 0;
+                uint32_t size = 0;
+
+                ok = memory::safe_copy(&buffer, collection + layout.buffer_offset, sizeof(buffer))
+                    && memory::safe_copy(&size, collection + layout.size_offset, sizeof(size));
+                if (!ok)
+                {
+                    break;
+                }
+
+                if (!buffer || !size)
+                {
+                    pc = inst.imm + 1;
+                    continue;
+                }
+
+                // NEXT loads the first element
+                loops[depth++] = { pc + 1, static_cast<size_t>(inst.imm), buffer + avm::COLLECTION_ELEMENTS,
+                                   UINT32_MAX, std::min(size, MAX_ELEMENTS), inst.a, pos };
+                pc = inst.imm;
+                continue;
+            }
+            case Op::NEXT:
+            {
+                Loop &loop = loops[depth - 1];
+                bool loaded = false;
+
+                while (!loaded && ++loop.index < loop.size)
+                {
+                    uintptr_t element = 0;
+                    if ((loaded = memory::safe_copy(&element, loop.elements + loop.index * sizeof(uintptr_t), sizeof(element))))
+                    {
+                        r[loop.reg] = element & ~7ULL;
+                    }
+                    else
+                    {
+                        flags |= SKIPPED;
+                    }
+                }
+
+                if (loaded)
+                {
+                    loop.mark = pos;
+                    pc = loop.body;
+                    continue;
+                }
+                depth--;
+                break;
+            }
+            case Op::SKIP_EQ:
+            case Op::SKIP_NE:
+            case Op::SKIP_LT:
+            case Op::SKIP_GE:
+            {
+                int64_t value = static_cast<int64_t>(r[inst.a]);
+                bool skip = (inst.op == Op::SKIP_EQ) ? value == inst.imm
+                          : (inst.op == Op::SKIP_NE) ? value != inst.imm
+                          : (inst.op == Op::SKIP_LT) ? value < inst.imm
+                          : value >= inst.imm;
+                if (skip)
+                {
+                    pc += inst.c + 1;
+                    continue;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (!ok)
+        {
+            if (!depth)
+            {
+                flags |= FAULTED;
+                break;
+            }
+
+            // drop what this element wrote and go on with the next one
+            pos = loops[depth - 1].mark;
+            pc = loops[depth - 1].next;
+            flags |= SKIPPED;
+            continue;
+        }
+
+        pc++;
+    }
+
+    return pos;
+}
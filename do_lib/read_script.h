@@ -0,0 +1,73 @@
+#ifndef READ_SCRIPT_H
+#define READ_SCRIPT_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Small read only programs sent by the client and run on the flash thread every tick.
+// Eight 64 bit registers, r0-r3 start with the roots given at registration. All memory
+// access goes through memory::safe_copy: a fault inside a FOR_EACH body drops the output
+// of that element and continues with the next one, a fault outside of a loop stops the run.
+namespace read_script
+{
+    enum class Op : uint8_t
+    {
+        END,        // stop
+        MOV,        // r[a] = r[b]
+        SET,        // r[a] = imm
+        ADD,        // r[a] += imm
+        AND,        // r[a] &= imm, imm -8 strips the atom tag
+        READ,       // r[a] = c bytes (1, 2, 4 or 8) at r[b] + imm, zero extended
+        EMIT,       // output c bytes at r[a] + imm
+        EMIT_REG,   // output r[a]
+        FOR_EACH,   // r[a] = every element of the Array (c = 0) or Vector (c = 1) in r[b], imm = index of its NEXT
+        NEXT,       // end of the FOR_EACH body
+        SKIP_EQ,    // skip the next c instructions if r[a] == imm, skipping up to a NEXT continues the loop
+        SKIP_NE,
+        SKIP_LT,    // signed
+        SKIP_GE,
+        COUNT
+    };
+
+    struct Instruction
+    {
+        Op op;
+        uint8_t a, b, c;
+        int32_t imm;
+    };
+
+    static_assert(sizeof(Instruction) == 8, "Instructions are sent as 64 bit words");
+
+    // Result flags of a run
+    enum : uint32_t
+    {
+        FAULTED     = 1,    // stopped on an unreadable address outside of a loop
+        TRUNCATED   = 2,    // output or step limit reached
+        SKIPPED     = 4     // elements were dropped after a fault
+    };
+
+    static constexpr size_t REGISTERS = 8;
+    static constexpr size_t ROOTS = 4;
+    static constexpr size_t MAX_INSTRUCTIONS = 256;
+    static constexpr size_t MAX_DEPTH = 4;
+    static constexpr size_t MAX_STEPS = 1 << 20;
+    static constexpr uint32_t MAX_ELEMENTS = 0x10000;
+
+    class Script
+    {
+    public:
+        // Validates the code, error says why it was rejected
+        bool load(const Instruction *code, size_t count, const uint64_t *roots, std::string &error);
+
+        // Writes at most max bytes to out, returns the size written and sets flags. Every
+        // step is taken from budget, the run stops TRUNCATED once it is used up.
+        size_t run(uint8_t *out, size_t max, uint32_t &flags, size_t &budget) const;
+
+    private:
+        std::vector<Instruction> m_code;
+        uint64_t m_roots[ROOTS] = { };
+    };
+}
+
+#endif /* READ_SCRIPT_H */
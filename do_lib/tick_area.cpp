@@ -0,0 +1,208 @@
+#include "tick_area.h"
+
+#include <cstring>
+#include <string>
+
+#include "memory.h"
+#include "utils.h"
+
+void TickArea::attach(uint8_t *memory, size_t size)
+{
+    std::scoped_lock lk { m_mutex };
+    m_memory = (size >= sizeof(Header)) ? memory : nullptr;
+    m_size = size & ~size_t(7);
+}
+
+int TickArea::register_script(const read_script::Instruction *code, size_t count, const uint64_t *roots)
+{
+    auto script = std::make_unique<read_script::Script>();
+
+    std::string error;
+    if (!script->load(code, count, roots, error))
+    {
+        utils::log("[!] Rejected read script: {}\n", error);
+        return -1;
+    }
+
+    std::scoped_lock lk { m_mutex };
+    for (size_t i = 0; i < m_scripts.size(); i++)
+    {
+        if (!m_scripts[i])
+        {
+            m_scripts[i] = std::move(script);
+            utils::log("[+] Registered read script {} ({} instructions)\n", i, count);
+            return static_cast<int>(i);
+        }
+    }
+
+    utils::log("[!] No free read script slot\n");
+    return -1;
+}
+
+bool TickArea::unregister_script(int id)
+{
+    std::scoped_lock lk { m_mutex };
+    if (id < 0 || static_cast<size_t>(id) >= m_scripts.size() || !m_scripts[id])
+    {
+        return false;
+    }
+    m_scripts[id].reset();
+    return true;
+}
+
+int TickArea::register_reads(const ReadEntry *entries, size_t count)
+{
+    if (count == 0 || count > MAX_READS)
+    {
+        utils::log("[!] Rejected read set of {} entries\n", count);
+        return -1;
+    }
+
+    auto set = std::make_unique<ReadSet>();
+    set->entries.assign(entries, entries + count);
+    set->data_size = (count + 63) / 64 * 8;
+
+    for (const auto &entry : set->entries)
+    {
+        if (entry.size == 0 || entry.size > MAX_READ_SIZE)
+        {
+            utils::log("[!] Rejected read set, bad size {}\n", entry.size);
+            return -1;
+        }
+        set->data_size += entry.size;
+    }
+
+    std::scoped_lock lk { m_mutex };
+
+    // would come back TRUNCATED every tick even with the frame to itself
+    if (m_size < sizeof(Header) + sizeof(Record) || set->data_size > m_size - sizeof(Header) - sizeof(Record))
+    {
+        utils::log("[!] Rejected read set, {} bytes do not fit into a frame\n", set->data_size);
+        return -1;
+    }
+
+    for (size_t i = 0; i < m_read_sets.size(); i++)
+    {
+        if (!m_read_sets[i])
+        {
+            m_read_sets[i] = std::move(set);
+            utils::log("[+] Registered read set {} ({} reads)\n", i, count);
+            return static_cast<int>(i);
+        }
+    }
+
+    utils::log("[!] No free read set slot\n");
+    return -1;
+}
+
+bool TickArea::unregister_reads(int id)
+{
+    std::scoped_lock lk { m_mutex };
+    if (id < 0 || static_cast<size_t>(id) >= m_read_sets.size() || !m_read_sets[id])
+    {
+        return false;
+    }
+    m_read_sets[id].reset();
+    return true;
+}
+
+void TickArea::clear()
+{
+    std::scoped_lock lk { m_mutex };
+    for (auto &script : m_scripts)
+    {
+        script.reset();
+    }
+    for (auto &set : m_read_sets)
+    {
+        set.reset();
+    }
+}
+
+size_t TickArea::copy_reads(const ReadSet &set, uint8_t *out, size_t max, uint32_t &flags)
+{
+    if (set.data_size > max)
+    {
+        flags |= read_script::TRUNCATED;
+        return 0;
+    }
+
+    size_t bitmap_size = (set.entries.size() + 63) / 64 * 8;
+    std::memset(out, 0, bitmap_size);
+
+    size_t pos = bitmap_size;
+    for (size_t i = 0; i < set.entries.size(); i++)
+    {
+        const auto &entry = set.entries[i];
+        if (memory::safe_copy(out + pos, entry.address, entry.size))
+        {
+            out[i / 8] |= 1 << (i % 8);
+        }
+        else
+        {
+            std::memset(out + pos, 0, entry.size);
+            flags |= read_script::SKIPPED;
+        }
+        pos += entry.size;
+    }
+    return pos;
+}
+
+template<typename F>
+size_t TickArea::write_record(size_t pos, uint32_t id, RecordKind kind, F &&write)
+{
+    if (pos + sizeof(Record) > m_size)
+    {
+        return pos;
+    }
+
+    uint32_t flags = 0;
+    size_t size = write(m_memory + pos + sizeof(Record), m_size - pos - sizeof(Record), flags);
+
+    auto *record = reinterpret_cast<Record *>(m_memory + pos);
+    *record = { id, flags, static_cast<uint32_t>(size), kind };
+    return pos + sizeof(Record) + ((size + 7) & ~size_t(7));
+}
+
+void TickArea::update()
+{
+    std::scoped_lock lk { m_mutex };
+    if (!m_memory)
+    {
+        return;
+    }
+
+    auto *header = reinterpret_cast<Header *>(m_memory);
+    uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t pos = sizeof(Header);
+    size_t budget = MAX_TICK_STEPS;
+    for (size_t i = 0; i < m_scripts.size(); i++)
+    {
+        if (auto *script = m_scripts[i].get())
+        {
+            // scripts after the one that used up the budget get an empty TRUNCATED record
+            pos = write_record(pos, i, SCRIPT, [script, &budget] (uint8_t *out, size_t max, uint32_t &flags)
+            {
+                return script->run(out, max, flags, budget);
+            });
+        }
+    }
+    for (size_t i = 0; i < m_read_sets.size(); i++)
+    {
+        if (auto *set = m_read_sets[i].get())
+        {
+            pos = write_record(pos, i, READ_SET, [set] (uint8_t *out, size_t max, uint32_t &flags)
+            {
+                return copy_reads(*set, out, max, flags);
+            });
+        }
+    }
+
+    header->tick = ++m_tick;
+    header->size = static_cast<uint32_t>(pos - sizeof(Header));
+    header->sequence.store(sequence + 2, std::memory_order_release);
+}
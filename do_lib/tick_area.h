@@ -0,0 +1,99 @@
+#ifndef TICK_AREA_H
+#define TICK_AREA_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "read_script.h"
+
+// Shared memory that the flash thread rewrites at the end of every tick under a sequence
+// lock: the sequence is odd while a frame is written, readers copy the frame and retry if
+// the sequence changed meanwhile. A frame is a Header followed by 8 byte aligned records,
+// one per registered script and read set.
+class TickArea
+{
+public:
+    static constexpr size_t MAX_SCRIPTS = 16;
+    static constexpr size_t MAX_READ_SETS = 16;
+    static constexpr size_t MAX_READS = 512;    // per set
+    static constexpr uint32_t MAX_READ_SIZE = 0x1000;
+
+    // Script steps per tick, shared by all scripts so they can not stall a frame together
+    static constexpr size_t MAX_TICK_STEPS = 1 << 18;
+
+    enum RecordKind : uint32_t
+    {
+        SCRIPT,
+        READ_SET
+    };
+
+    struct Header
+    {
+        std::atomic<uint32_t> sequence;
+        uint32_t tick;
+        uint32_t size;      // of the records
+        uint32_t reserved;
+    };
+
+    struct Record
+    {
+        uint32_t id;
+        uint32_t flags;     // read_script result flags
+        uint32_t size;      // of the data that follows, without padding
+        uint32_t kind;
+    };
+
+    // Read set data: a bitmap of the entries that could be read (padded to 8 bytes),
+    // then the bytes of every entry in order, zeroed where the read faulted
+    struct ReadEntry
+    {
+        uint64_t address;
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    void attach(uint8_t *memory, size_t size);
+
+    // Returns the script id or -1 if it does not validate or all slots are taken
+    int register_script(const read_script::Instruction *code, size_t count, const uint64_t *roots);
+
+    bool unregister_script(int id);
+
+    // Returns the read set id or -1
+    int register_reads(const ReadEntry *entries, size_t count);
+
+    bool unregister_reads(int id);
+
+    void clear();
+
+    // Runs the registered scripts, copies the read sets and publishes a new frame,
+    // flash thread only
+    void update();
+
+private:
+    struct ReadSet
+    {
+        std::vector<ReadEntry> entries;
+        size_t data_size;
+    };
+
+    // Writes a record at pos if there is room for its header, returns the next position
+    template<typename F>
+    size_t write_record(size_t pos, uint32_t id, RecordKind kind, F &&write);
+
+    static size_t copy_reads(const ReadSet &set, uint8_t *out, size_t max, uint32_t &flags);
+
+    std::mutex m_mutex;
+    std::array<std::unique_ptr<read_script::Script>, MAX_SCRIPTS> m_scripts;
+    std::array<std::unique_ptr<ReadSet>, MAX_READ_SETS> m_read_sets;
+
+    uint8_t *m_memory = nullptr;
+    size_t m_size = 0;
+    uint32_t m_tick = 0;
+};
+
+#endif /* TICK_AREA_H */
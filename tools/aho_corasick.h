@@ -0,0 +1,132 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <array>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Multi-pattern substring matcher (header-only). Every pattern carries a value, find()
+// returns the lowest value of all patterns occurring in the text in one pass over it.
+// The automaton is a full transition table, meant for a handful of short patterns.
+class AhoCorasick
+{
+public:
+    void add(std::string_view pattern, int32_t value)
+    {
+        m_patterns.emplace_back(std::string(pattern), value);
+        build();
+    }
+
+    void clear()
+    {
+        m_patterns.clear();
+        m_nodes.clear();
+    }
+
+    inline bool empty() const
+    {
+        return m_patterns.empty();
+    }
+
+    // Lowest value of the patterns found in text, -1 if none
+    int32_t find(std::string_view text) const
+    {
+        if (m_nodes.empty())
+        {
+            return -1;
+        }
+
+        int32_t best = -1;
+        uint32_t state = 0;
+        for (char c : text)
+        {
+            state = m_nodes[state].next[static_cast<uint8_t>(c)];
+            int32_t value = m_nodes[state].value;
+            if (value >= 0 && (best < 0 || value < best))
+            {
+                best = value;
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Node
+    {
+        std::array<uint32_t, 256> next { };
+        uint32_t fail = 0;
+        int32_t value = -1;     // lowest value ending here or at any suffix of this node
+    };
+
+    void build()
+    {
+        m_nodes.assign(1, Node { });
+
+        // trie, a 0 transition is missing until the links below fill it in
+        for (auto &[pattern, value] : m_patterns)
+        {
+            uint32_t state = 0;
+            for (char c : pattern)
+            {
+                auto &next = m_nodes[state].next[static_cast<uint8_t>(c)];
+                if (!next)
+                {
+                    next = static_cast<uint32_t>(m_nodes.size());
+                    m_nodes.emplace_back();
+                }
+                state = m_nodes[state].next[static_cast<uint8_t>(c)];
+            }
+
+            int32_t &own = m_nodes[state].value;
+            if (own < 0 || value < own)
+            {
+                own = value;
+            }
+        }
+
+        // breadth first, a node's fail link is complete before its children need it
+        std::queue<uint32_t> queue;
+        for (uint32_t child : m_nodes[0].next)
+        {
+            if (child)
+            {
+                queue.push(child);
+            }
+        }
+
+        while (!queue.empty())
+        {
+            uint32_t state = queue.front();
+            queue.pop();
+
+            const Node &fail = m_nodes[m_nodes[state].fail];
+            if (fail.value >= 0 && (m_nodes[state].value < 0 || fail.value < m_nodes[state].value))
+            {
+                m_nodes[state].value = fail.value;
+            }
+
+            for (size_t c = 0; c < 256; c++)
+            {
+                uint32_t child = m_nodes[state].next[c];
+                uint32_t fallback = m_nodes[m_nodes[state].fail].next[c];
+                if (child)
+                {
+                    m_nodes[child].fail = fallback;
+                    queue.push(child);
+                }
+                else
+                {
+                    m_nodes[state].next[c] = fallback;
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, int32_t>> m_patterns;
+    std::vector<Node> m_nodes;
+};
+
+#endif // AHO_CORASICK_H
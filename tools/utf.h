@@ -0,0 +1,279 @@
+#ifndef TOOLS_UTF_H
+#define TOOLS_UTF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace utf
+{
+    // Writes a code point as utf-8, returns the number of bytes (1-4)
+    static inline size_t encode(uint32_t cp, uint8_t *out)
+    {
+        if (cp < 0x80)
+        {
+            out[0] = static_cast<uint8_t>(cp);
+            return 1;
+        }
+        if (cp < 0x800)
+        {
+            out[0] = static_cast<uint8_t>(0xc0 | (cp >> 6));
+            out[1] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+            return 2;
+        }
+        if (cp < 0x10000)
+        {
+            out[0] = static_cast<uint8_t>(0xe0 | (cp >> 12));
+            out[1] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3f));
+            out[2] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+            return 3;
+        }
+        out[0] = static_cast<uint8_t>(0xf0 | (cp >> 18));
+        out[1] = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3f));
+        out[2] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3f));
+        out[3] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+        return 4;
+    }
+
+    // Size of the longest prefix of s within max bytes that does not end inside a character
+    static inline size_t truncate(std::string_view s, size_t max)
+    {
+        if (s.size() <= max)
+        {
+            return s.size();
+        }
+
+        // the first byte left out must start a character, step back over continuation bytes
+        size_t size = max;
+        while (size > 0 && (static_cast<uint8_t>(s[size]) & 0xc0) == 0x80)
+        {
+            size--;
+        }
+        return size;
+    }
+
+    // Calls f(code_point) for every character of an utf-16 string,
+    // unpaired surrogates are passed through as they are
+    template<typename F>
+    static inline void for_each_code_point(const char16_t *data, size_t size, F &&f)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            uint32_t c = data[i];
+            if (c >= 0xd800 && c < 0xdc00 && i + 1 < size)
+            {
+                uint32_t low = data[i + 1];
+                if (low >= 0xdc00 && low < 0xe000)
+                {
+                    c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                    i++;
+                }
+            }
+            f(c);
+        }
+    }
+
+    // Number of leading characters below 0x80, 16 (8 wide) characters per step with sse2
+    static inline size_t ascii_prefix(const uint8_t *data, size_t size)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            if (_mm_movemask_epi8(v))
+            {
+                break;
+            }
+        }
+#endif
+        while (i < size && data[i] < 0x80)
+        {
+            i++;
+        }
+        return i;
+    }
+
+    static inline size_t ascii_prefix(const char16_t *data, size_t size)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i high = _mm_set1_epi16(static_cast<short>(0xff80));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= size; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero)) != 0xffff)
+            {
+                break;
+            }
+        }
+#endif
+        while (i < size && data[i] < 0x80)
+        {
+            i++;
+        }
+        return i;
+    }
+
+    // Appends ascii utf-16 characters as bytes, size has to come from ascii_prefix
+    static inline void append_ascii(std::string &out, const char16_t *data, size_t size)
+    {
+        size_t start = out.size();
+        out.resize(start + size);
+        char *dst = &out[start];
+
+        size_t i = 0;
+#ifdef __SSE2__
+        for (; i + 8 <= size; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(v, v));
+        }
+#endif
+        for (; i < size; i++)
+        {
+            dst[i] = static_cast<char>(data[i]);
+        }
+    }
+
+    static inline std::string from_utf16(const char16_t *data, size_t size)
+    {
+        std::string out;
+        out.reserve(size);
+
+        size_t i = 0;
+        while (i < size)
+        {
+            size_t ascii = ascii_prefix(data + i, size - i);
+            append_ascii(out, data + i, ascii);
+            i += ascii;
+
+            // slow path up to the next ascii character, surrogate pairs are kept together
+            size_t run = i;
+            while (run < size && data[run] >= 0x80)
+            {
+                run++;
+            }
+            for_each_code_point(data + i, run - i, [&out] (uint32_t cp)
+            {
+                uint8_t buf[4];
+                out.append(reinterpret_cast<char *>(buf), encode(cp, buf));
+            });
+            i = run;
+        }
+        return out;
+    }
+
+    static inline std::string from_latin1(const uint8_t *data, size_t size)
+    {
+        size_t ascii = ascii_prefix(data, size);
+        std::string out(reinterpret_cast<const char *>(data), ascii);
+
+        if (ascii < size)
+        {
+            out.reserve(size + (size - ascii));
+            for (size_t i = ascii; i < size; i++)
+            {
+                uint8_t buf[4];
+                out.append(reinterpret_cast<char *>(buf), encode(data[i], buf));
+            }
+        }
+        return out;
+    }
+
+    // Decodes utf-8 (as produced above) back to utf-16, malformed bytes become U+FFFD
+    static inline std::u16string to_utf16(std::string_view s)
+    {
+        std::u16string out;
+        out.reserve(s.size());
+
+        size_t i = 0;
+        while (i < s.size())
+        {
+            uint8_t c = static_cast<uint8_t>(s[i]);
+            size_t n = (c < 0x80) ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+
+            if (n == 0 || i + n > s.size())
+            {
+                out.push_back(0xfffd);
+                i++;
+                continue;
+            }
+
+            uint32_t cp = (n == 1) ? c : c & (0x7f >> n);
+            for (size_t k = 1; k < n; k++)
+            {
+                cp = (cp << 6) | (static_cast<uint8_t>(s[i + k]) & 0x3f);
+            }
+
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                out.push_back(static_cast<char16_t>(0xd800 + (cp >> 10)));
+                out.push_back(static_cast<char16_t>(0xdc00 + (cp & 0x3ff)));
+            }
+            else
+            {
+                out.push_back(static_cast<char16_t>(cp));
+            }
+            i += n;
+        }
+        return out;
+    }
+
+    // Compares the utf-8 form of a string with s without building it
+    template<typename Char>
+    static inline bool equals(const Char *data, size_t size, std::string_view s)
+    {
+        // every character takes at least one byte, at most three (pairs: 4 bytes for 2)
+        if (size > s.size() || s.size() > size * 3)
+        {
+            return false;
+        }
+
+        size_t ascii = ascii_prefix(data, size);
+        for (size_t i = 0; i < ascii; i++)
+        {
+            if (static_cast<uint8_t>(s[i]) != data[i])
+            {
+                return false;
+            }
+        }
+
+        size_t pos = ascii;
+        bool equal = true;
+        auto compare = [&s, &pos, &equal] (uint32_t cp)
+        {
+            uint8_t buf[4];
+            size_t n = encode(cp, buf);
+            if (!equal || pos + n > s.size() || std::memcmp(s.data() + pos, buf, n) != 0)
+            {
+                equal = false;
+                return;
+            }
+            pos += n;
+        };
+
+        if constexpr (sizeof(Char) == 2)
+        {
+            for_each_code_point(data + ascii, size - ascii, compare);
+        }
+        else
+        {
+            for (size_t i = ascii; i < size && equal; i++)
+            {
+                compare(data[i]);
+            }
+        }
+        return equal && pos == s.size();
+    }
+}
+
+#endif /* TOOLS_UTF_H */
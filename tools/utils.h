@@ -2,11 +2,13 @@
 #define TOOLS_UTILS_H
 
 #include <cmath>
+#include <cstdint>
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 #ifndef LOG_FILE
 #define LOG_FILE "/tmp/do_output.txt"
@@ -114,6 +116,29 @@ namespace utils
         return res;
     }
 
+    // 64-bit FNV-1a, fed incrementally so callers can hash data they convert on the fly
+    struct Fnv1a
+    {
+        uint64_t value = 0xcbf29ce484222325ULL;
+
+        inline void add(const void *data, size_t size)
+        {
+            auto *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                value ^= bytes[i];
+                value *= 0x100000001b3ULL;
+            }
+        }
+    };
+
+    static inline uint64_t fnv1a(std::string_view s)
+    {
+        Fnv1a h;
+        h.add(s.data(), s.size());
+        return h.value;
+    }
+
     class vec2
     {
     public: